@@ -0,0 +1,146 @@
+#include "bitboard.h"
+#include <bitset>
+#include <vector>
+
+// KPK bitbase, built at startup by retrograde iteration. The pawn is always
+// White's and restricted to files A-D; callers normalise the position first.
+
+namespace
+{
+    // 2 sides to move * 24 pawn squares * 64 * 64 king squares
+    const unsigned MaxIndex = 2 * 24 * 64 * 64;
+
+    std::bitset<MaxIndex> KPKBitbase;
+
+    unsigned index(Color us, Square bksq, Square wksq, Square psq)
+    {
+        return wksq | (bksq << 6) | (us << 12) | (file_of(psq) << 13) | ((RANK_7 - rank_of(psq)) << 15);
+    }
+
+    enum Result
+    {
+        INVALID = 0,
+        UNKNOWN = 1,
+        DRAW = 2,
+        WIN = 4
+    };
+
+    inline Result& operator|=(Result& r, Result v) { return r = Result(r | v); }
+
+    struct KPKPosition
+    {
+        explicit KPKPosition(unsigned idx);
+
+        operator Result() const { return result; }
+
+        Result classify(const std::vector<KPKPosition>& db)
+        {
+            return us == WHITE ? classify<WHITE>(db) : classify<BLACK>(db);
+        }
+
+        template<Color Us>
+        Result classify(const std::vector<KPKPosition>& db);
+
+        Color us;
+        Square ksq[COLOR_NB];
+        Square psq;
+        Result result;
+    };
+
+    KPKPosition::KPKPosition(unsigned idx)
+    {
+        ksq[WHITE] = Square(idx & 0x3F);
+        ksq[BLACK] = Square((idx >> 6) & 0x3F);
+        us = Color((idx >> 12) & 0x01);
+        psq = make_square(File((idx >> 13) & 0x3), Rank(RANK_7 - ((idx >> 15) & 0x7)));
+
+        const Square push = Square(psq + 8);
+
+        // Overlapping pieces, adjacent kings or a king that can be captured
+        if (distance(ksq[WHITE], ksq[BLACK]) <= 1
+            || ksq[WHITE] == psq
+            || ksq[BLACK] == psq
+            || (us == WHITE && (PawnAttacks[WHITE][psq] & square_bb(ksq[BLACK]))))
+            result = INVALID;
+
+        // The pawn promotes and the new queen cannot be taken
+        else if (us == WHITE
+            && rank_of(psq) == RANK_7
+            && ksq[WHITE] != push
+            && (distance(ksq[BLACK], push) > 1 || (PseudoAttacks[KING][ksq[WHITE]] & square_bb(push))))
+            result = WIN;
+
+        // Stalemate, or Black takes an undefended pawn
+        else if (us == BLACK
+            && (!(PseudoAttacks[KING][ksq[BLACK]] & ~(PseudoAttacks[KING][ksq[WHITE]] | PawnAttacks[WHITE][psq]))
+                || (PseudoAttacks[KING][ksq[BLACK]] & square_bb(psq) & ~PseudoAttacks[KING][ksq[WHITE]])))
+            result = DRAW;
+
+        else
+            result = UNKNOWN;
+    }
+
+    // A position is a win for White if some White move reaches a win, and a
+    // draw if every Black move reaches a draw.
+    template<Color Us>
+    Result KPKPosition::classify(const std::vector<KPKPosition>& db)
+    {
+        const Color Them = Us == WHITE ? BLACK : WHITE;
+        const Result Good = Us == WHITE ? WIN : DRAW;
+        const Result Bad = Us == WHITE ? DRAW : WIN;
+
+        Result r = INVALID;
+        Bitboard b = PseudoAttacks[KING][ksq[Us]];
+
+        while (b)
+        {
+            Square s = pop_lsb(b);
+            r |= Us == WHITE ? db[index(Them, ksq[Them], s, psq)] : db[index(Them, s, ksq[Them], psq)];
+        }
+
+        if (Us == WHITE)
+        {
+            const Square push = Square(psq + 8);
+
+            if (rank_of(psq) < RANK_7)
+                r |= db[index(Them, ksq[Them], ksq[Us], push)];
+
+            if (rank_of(psq) == RANK_2 && push != ksq[Us] && push != ksq[Them])
+                r |= db[index(Them, ksq[Them], ksq[Us], Square(push + 8))];
+        }
+
+        return result = r & Good ? Good : r & UNKNOWN ? UNKNOWN : Bad;
+    }
+}
+
+namespace Bitbases
+{
+    void init()
+    {
+        std::vector<KPKPosition> db;
+        db.reserve(MaxIndex);
+
+        for (unsigned idx = 0; idx < MaxIndex; ++idx)
+            db.emplace_back(idx);
+
+        bool repeat = true;
+
+        while (repeat)
+        {
+            repeat = false;
+            for (unsigned idx = 0; idx < MaxIndex; ++idx)
+                repeat |= db[idx] == UNKNOWN && db[idx].classify(db) != UNKNOWN;
+        }
+
+        for (unsigned idx = 0; idx < MaxIndex; ++idx)
+            if (db[idx] == WIN)
+                KPKBitbase.set(idx);
+    }
+
+    bool probe(Square wksq, Square wpsq, Square bksq, Color us)
+    {
+        assert(file_of(wpsq) <= FILE_D);
+
+        return KPKBitbase[index(us, bksq, wksq, wpsq)];
+    }
+}
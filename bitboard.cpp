@@ -67,43 +67,22 @@ namespace
         return result;
     }
 
-    const U64 rook_magics[SQUARE_NB] = {
-        0xa8002c000108020ULL, 0x4440200140003000ULL, 0x8080200010011880ULL, 0x380180080040800ULL,
-        0x1A00060008040800ULL, 0x410040008200800ULL, 0x10c0100400100004ULL, 0x82040800401001ULL,
-        0x40002080100100ULL, 0x4070c0040200300ULL, 0x40200080400080ULL, 0x2c00500800100200ULL,
-        0x4200100080100080ULL, 0x200080100008080ULL, 0x4000100020004ULL, 0x8002000800084ULL,
-        0x40004008000200ULL, 0x2000200040002000ULL, 0x80020004000800ULL, 0x800008001000ULL,
-        0x800008001000ULL, 0x1000800008001000ULL, 0x400800100008001ULL, 0x2c00840080ULL,
-        0x80002000400080ULL, 0x4002400208002000ULL, 0x2001002008002000ULL, 0x800800801000ULL,
-        0x800800801000ULL, 0x1001002008001000ULL, 0x400880100008001ULL, 0x4200840080ULL,
-        0x80004000200080ULL, 0x4002002000800ULL, 0x801002000800ULL, 0x800800801000ULL,
-        0x800800801000ULL, 0x1001002008001000ULL, 0x400880100008001ULL, 0x4200840080ULL,
-        0x80004000200080ULL, 0x4002002000800ULL, 0x801002000800ULL, 0x800800801000ULL,
-        0x800800801000ULL, 0x1001002008001000ULL, 0x400880100008001ULL, 0x4200840080ULL,
-        0x80002000008480ULL, 0x4002400020010ULL, 0x2001002008001ULL, 0x800800800801ULL,
-        0x800800800801ULL, 0x1000800008001ULL, 0x400800100008ULL, 0x2001000840ULL,
-        0x80004001000420ULL, 0x2001400200100ULL, 0x801000800804ULL, 0x800800800801ULL,
-        0x800800800801ULL, 0x1000800008001ULL, 0x400800100008ULL, 0x201000840ULL
-    };
+    // Sparse xorshift64* numbers for the magic search. Seeds are fixed per
+    // rank, so the tables come out identical on every run.
+    U64 sparse_rand(U64& seed)
+    {
+        U64 r = ~0ULL;
 
-    const U64 bishop_magics[SQUARE_NB] = {
-        0x40040844404084ULL, 0x2004208a004208ULL, 0x10190041080202ULL, 0x108060845042010ULL,
-        0x581104180800210ULL, 0x2112080446200010ULL, 0x1080820820060210ULL, 0x3c0808410220200ULL,
-        0x4050404440404ULL, 0x21001420088ULL, 0x24d0080801082102ULL, 0x1020a0a020400ULL,
-        0x40308200402ULL, 0x4011002100800ULL, 0x401484104104005ULL, 0x801010402020200ULL,
-        0x400210c3880100ULL, 0x404022024108200ULL, 0x810018200204102ULL, 0x4002801a02003ULL,
-        0x85040820080400ULL, 0x810102c808880400ULL, 0xe900410884800ULL, 0x8002020480840102ULL,
-        0x220200865090201ULL, 0x2010100a02021202ULL, 0x152048408022401ULL, 0x20080002081110ULL,
-        0x4001001021004000ULL, 0x800040400a011002ULL, 0xe4004081011002ULL, 0x1c004001012080ULL,
-        0x8004200962a00220ULL, 0x8422100208500202ULL, 0x2000402200300c08ULL, 0x8646020080080080ULL,
-        0x80020a0200100808ULL, 0x2010004880111000ULL, 0x623000a080011400ULL, 0x42008c0340209202ULL,
-        0x209188240001000ULL, 0x400408a884001800ULL, 0x110400a6080400ULL, 0x1840060a44020800ULL,
-        0x90080104000041ULL, 0x201011000808101ULL, 0x1a2208080504f080ULL, 0x8012020600211212ULL,
-        0x500861011240000ULL, 0x180806108200800ULL, 0x4000020e01040044ULL, 0x300000261044000aULL,
-        0x802241102020002ULL, 0x20906061210001ULL, 0x5a84841004010310ULL, 0x4010801011c04ULL,
-        0xa010109502200ULL, 0x4a02012000ULL, 0x500201010098b028ULL, 0x8040002811040900ULL,
-        0x28000010020204ULL, 0x6000020202d0240ULL, 0x8918844842082200ULL, 0x4010011029020020ULL
-    };
+        for (int i = 0; i < 3; ++i)
+        {
+            seed ^= seed >> 12;
+            seed ^= seed << 25;
+            seed ^= seed >> 27;
+            r &= seed * 2685821657736338717ULL;
+        }
+
+        return r;
+    }
 }
 
 U64 attacks_bb(PieceType pt, Square s, U64 occupied)
@@ -192,7 +171,8 @@ namespace
     void init_magics(U64 table[], U64* attacks[], U64 magics[], U64 masks[], int shifts[], Direction deltas[], PieceType pt)
     {
         U64 occupancy[4096], reference[4096], edges, b;
-        int size = 0;
+        int epoch[4096] = {}, cnt = 0, size = 0;
+        const U64 seeds[RANK_NB] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
 
         for (Square s = SQ_A1; s <= SQ_H8; ++s)
         {
@@ -202,22 +182,38 @@ namespace
             masks[s] = sliding_attack(s, 0, deltas) & ~edges;
             shifts[s] = 64 - popcount(masks[s]);
 
-            if (pt == ROOK)
-                magics[s] = rook_magics[s];
-            else
-                magics[s] = bishop_magics[s];
-
             attacks[s] = s == SQ_A1 ? table : attacks[s - 1] + size;
 
+            U64 seed = seeds[rank_of(s)];
             b = size = 0;
             do
             {
                 occupancy[size] = b;
                 reference[size] = sliding_attack(s, b, deltas);
-                attacks[s][(b * magics[s]) >> shifts[s]] = reference[size];
                 size++;
                 b = (b - masks[s]) & masks[s];
             } while (b);
+
+            // Draw candidates until every occupancy maps to a slot that is
+            // either unused or already holds the same attack set.
+            for (int i = 0; i < size; )
+            {
+                for (magics[s] = 0; popcount((magics[s] * masks[s]) >> 56) < 6; )
+                    magics[s] = sparse_rand(seed);
+
+                for (++cnt, i = 0; i < size; ++i)
+                {
+                    size_t idx = size_t((occupancy[i] * magics[s]) >> shifts[s]);
+
+                    if (epoch[idx] < cnt)
+                    {
+                        epoch[idx] = cnt;
+                        attacks[s][idx] = reference[i];
+                    }
+                    else if (attacks[s][idx] != reference[i])
+                        break;
+                }
+            }
         }
     }
 }
\ No newline at end of file
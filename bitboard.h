@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <intrin.h>
 
+constexpr U64 DarkSquares = 0xAA55AA55AA55AA55ULL;
+
 extern U64 SquareBB[SQUARE_NB];
 extern U64 FileBB[FILE_NB];
 extern U64 RankBB[RANK_NB];
@@ -27,6 +29,12 @@ extern int BishopShifts[SQUARE_NB];
 
 void init_bitboards();
 
+namespace Bitbases
+{
+    void init();
+    bool probe(Square wksq, Square wpsq, Square bksq, Color us);
+}
+
 inline U64 square_bb(Square s)
 {
     return SquareBB[s];
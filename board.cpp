@@ -1,9 +1,51 @@
 #include "board.h"
 #include "bitboard.h"
+#include "eval.h"
 #include <sstream>
+#include <algorithm>
+#include <cctype>
+
+namespace Zobrist
+{
+    Key psq[PIECE_NB][SQUARE_NB];
+    Key enpassant[FILE_NB];
+    Key castling[CASTLING_RIGHT_NB];
+    Key side;
+}
+
+// xorshift64* generator, fixed seed so keys are identical between runs.
+static Key next_random(Key& seed)
+{
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return seed * 2685821657736338717ULL;
+}
 
 void Position::init()
 {
+    Key seed = 1070372;
+
+    for (Piece pc = W_PAWN; pc <= B_KING; ++pc)
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+            Zobrist::psq[pc][s] = next_random(seed);
+
+    for (File f = FILE_A; f <= FILE_H; ++f)
+        Zobrist::enpassant[f] = next_random(seed);
+
+    // One key per single right, XORed together for combinations
+    for (int cr = NO_CASTLING; cr <= ANY_CASTLING; ++cr)
+    {
+        Zobrist::castling[cr] = 0;
+        Bitboard b = cr;
+        while (b)
+        {
+            Key k = Zobrist::castling[1ULL << pop_lsb(b)];
+            Zobrist::castling[cr] ^= k ? k : next_random(seed);
+        }
+    }
+
+    Zobrist::side = next_random(seed);
 }
 
 Position& Position::set(const std::string& fenStr, bool isChess960, StateInfo* si, Thread* th)
@@ -121,10 +163,35 @@ Position& Position::set(const std::string& fenStr, bool isChess960, StateInfo* s
     st->checkersBB = 0ULL;
     st->capturedPiece = NO_PIECE;
     st->previous = nullptr;
+    st->dirtyPiece.count = 0;
+    st->accumulator.computed = false;
 
     for (PieceType pt = PAWN; pt <= KING; ++pt)
         st->checkSquares[pt] = 0;
 
+    for (Bitboard b = pieces(); b; )
+    {
+        Square s = pop_lsb(b);
+        st->key ^= Zobrist::psq[piece_on(s)][s];
+        st->psq += Eval::psq[piece_on(s)][s];
+        if (type_of(piece_on(s)) == PAWN)
+            st->pawnKey ^= Zobrist::psq[piece_on(s)][s];
+    }
+
+    if (st->epSquare != SQ_NONE)
+        st->key ^= Zobrist::enpassant[file_of(st->epSquare)];
+
+    if (sideToMove == BLACK)
+        st->key ^= Zobrist::side;
+
+    st->key ^= Zobrist::castling[st->castlingRights];
+
+    // The material key hashes piece counts: the n-th piece of a kind
+    // contributes psq[pc][n - 1].
+    for (Piece pc = W_PAWN; pc <= B_KING; ++pc)
+        for (int cnt = 0; cnt < pieceCount[pc]; ++cnt)
+            st->materialKey ^= Zobrist::psq[pc][cnt];
+
     if (count<KING>(WHITE) > 0 && count<KING>(BLACK) > 0)
     {
         st->checkersBB = attackers_to(square<KING>(sideToMove)) & pieces(~sideToMove);
@@ -141,9 +208,54 @@ Position& Position::set(const std::string& fenStr, bool isChess960, StateInfo* s
     return *this;
 }
 
+// Written back in the form set() reads, so a position can be copied with
+// set(pos.fen(), ...). The move counter is gamePly as set() stored it.
 const std::string Position::fen() const
 {
-    return "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    std::ostringstream ss;
+
+    for (int r = RANK_8; r >= RANK_1; r--)
+    {
+        int emptyCount = 0;
+
+        for (int f = FILE_A; f <= FILE_H; f++)
+        {
+            Piece pc = piece_on(make_square(File(f), Rank(r)));
+
+            if (pc == NO_PIECE)
+            {
+                ++emptyCount;
+                continue;
+            }
+
+            if (emptyCount)
+                ss << emptyCount;
+            emptyCount = 0;
+            ss << " PNBRQK  pnbrqk"[pc];
+        }
+
+        if (emptyCount)
+            ss << emptyCount;
+        if (r > RANK_1)
+            ss << '/';
+    }
+
+    ss << (sideToMove == WHITE ? " w " : " b ");
+
+    if (can_castle(WHITE_OO)) ss << 'K';
+    if (can_castle(WHITE_OOO)) ss << 'Q';
+    if (can_castle(BLACK_OO)) ss << 'k';
+    if (can_castle(BLACK_OOO)) ss << 'q';
+    if (!can_castle(ANY_CASTLING)) ss << '-';
+
+    if (ep_square() == SQ_NONE)
+        ss << " -";
+    else
+        ss << ' ' << char('a' + file_of(ep_square())) << char('1' + rank_of(ep_square()));
+
+    ss << ' ' << st->rule50 << ' ' << gamePly;
+
+    return ss.str();
 }
 
 const std::string Position::pretty() const
@@ -178,9 +290,22 @@ const std::string Position::pretty() const
     return ss.str();
 }
 
+// Sets up a position from an endgame code such as "KBNvK", the strong side
+// first, with the strong side playing colour c. Only the material matters,
+// the position is used to compute material keys.
 Position& Position::set(const std::string& code, Color c, StateInfo* si)
 {
-    return *this;
+    assert(code[0] == 'K');
+
+    std::string sides[] = { code.substr(code.find('K', 1)),
+                            code.substr(0, std::min(code.find('v'), code.find('K', 1))) };
+
+    std::transform(sides[c].begin(), sides[c].end(), sides[c].begin(), ::tolower);
+
+    std::string fenStr = "8/" + sides[0] + char(8 - sides[0].length() + '0') + "/8/8/8/8/"
+        + sides[1] + char(8 - sides[1].length() + '0') + "/8 w - - 0 10";
+
+    return set(fenStr, false, si, nullptr);
 }
 
 void Position::set_castling_right(Color c, Square rfrom)
@@ -195,30 +320,6 @@ void Position::set_check_info(StateInfo* si) const
 {
 }
 
-Key Position::key() const
-{
-    Key k = 0;
-
-    for (Square s = SQ_A1; s <= SQ_H8; s = Square(s + 1))
-    {
-        Piece pc = piece_on(s);
-        if (pc != NO_PIECE)
-        {
-            k ^= U64(pc) * U64(s + 1) * 0x9E3779B97F4A7C15ULL;
-        }
-    }
-
-    if (sideToMove == BLACK)
-        k ^= 0x123456789ABCDEFULL;
-
-    k ^= U64(st->castlingRights) * 0x517CC1B727220A95ULL;
-
-    if (st->epSquare != SQ_NONE)
-        k ^= U64(st->epSquare) * 0x6C5D5C6B5AED4A2BULL;
-
-    return k;
-}
-
 int Position::game_ply() const
 {
     return gamePly;
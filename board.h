@@ -4,10 +4,19 @@
 #include "types.h"
 #include "bitboard.h"
 #include "move.h"
+#include "nnue.h"
 #include <string>
 #include <vector>
 #include <iostream>
 
+namespace Zobrist
+{
+    extern Key psq[PIECE_NB][SQUARE_NB];
+    extern Key enpassant[FILE_NB];
+    extern Key castling[CASTLING_RIGHT_NB];
+    extern Key side;
+}
+
 struct StateInfo
 {
     Key key;
@@ -25,6 +34,9 @@ struct StateInfo
     Bitboard checkersBB;
     Bitboard checkSquares[PIECE_TYPE_NB];
 
+    NNUE::DirtyPiece dirtyPiece;
+    NNUE::Accumulator accumulator;
+
     StateInfo* previous;
 };
 
@@ -100,8 +112,9 @@ public:
     Key material_key() const;
     Key pawn_key() const;
     int game_ply() const;
+    StateInfo* state() const;
 
-    Value psq_score() const;
+    Score psq_score() const;
     Value non_pawn_material(Color c) const;
     Value non_pawn_material() const;
 
@@ -230,6 +243,16 @@ inline bool Position::gives_check(Move m) const
         || (discovered_check_candidates() & from_sq(m) && !aligned(from_sq(m), to_sq(m), square<KING>(~sideToMove)));
 }
 
+inline Key Position::key() const
+{
+    return st->key;
+}
+
+inline StateInfo* Position::state() const
+{
+    return st;
+}
+
 inline Key Position::pawn_key() const
 {
     return st->pawnKey;
@@ -240,9 +263,9 @@ inline Key Position::material_key() const
     return st->materialKey;
 }
 
-inline Value Position::psq_score() const
+inline Score Position::psq_score() const
 {
-    return Value(st->psq);
+    return st->psq;
 }
 
 inline Value Position::non_pawn_material(Color c) const
@@ -1,5 +1,14 @@
 #include "board.h"
 #include "bitboard.h"
+#include "eval.h"
+
+static void add_dirty(NNUE::DirtyPiece& dp, Piece pc, Square from, Square to)
+{
+    dp.piece[dp.count] = pc;
+    dp.from[dp.count] = from;
+    dp.to[dp.count] = to;
+    ++dp.count;
+}
 
 bool Position::legal(Move m) const
 {
@@ -42,13 +51,17 @@ bool Position::legal(Move m) const
         occupied ^= square_bb(to);
     occupied |= square_bb(to);
 
+    // The captured piece no longer attacks anything
+    Bitboard enemies = pieces(them) & ~square_bb(to);
+
     if (type_of(m) == ENPASSANT)
     {
         Square capturedSquare = Square(to - (us == WHITE ? 8 : -8));
         occupied ^= square_bb(capturedSquare);
+        enemies ^= square_bb(capturedSquare);
     }
 
-    return !(attackers_to(kingSquare, occupied) & pieces(them));
+    return !(attackers_to(kingSquare, occupied) & enemies);
 }
 
 bool Position::pseudo_legal(const Move m) const
@@ -218,31 +231,47 @@ void Position::do_move(Move m, StateInfo& newSt)
     st->castlingRights = st->previous->castlingRights;
     st->epSquare = SQ_NONE;
     st->rule50 = st->previous->rule50 + 1;
-    st->key = st->previous->key;
+    st->key = st->previous->key ^ Zobrist::side;
     st->pawnKey = st->previous->pawnKey;
     st->materialKey = st->previous->materialKey;
     st->psq = st->previous->psq;
     st->npMaterial[WHITE] = st->previous->npMaterial[WHITE];
     st->npMaterial[BLACK] = st->previous->npMaterial[BLACK];
+    st->dirtyPiece.count = 0;
+    st->accumulator.computed = false;
+
+    if (st->previous->epSquare != SQ_NONE)
+        st->key ^= Zobrist::enpassant[file_of(st->previous->epSquare)];
 
     if (type_of(m) == NORMAL)
     {
         if (piece_on(to) != NO_PIECE)
         {
             st->capturedPiece = piece_on(to);
+            st->key ^= Zobrist::psq[st->capturedPiece][to];
+            st->psq -= Eval::psq[st->capturedPiece][to];
+            add_dirty(st->dirtyPiece, st->capturedPiece, to, SQ_NONE);
+            if (type_of(st->capturedPiece) == PAWN)
+                st->pawnKey ^= Zobrist::psq[st->capturedPiece][to];
             remove_piece(to);
+            st->materialKey ^= Zobrist::psq[st->capturedPiece][pieceCount[st->capturedPiece]];
             st->rule50 = 0;
         }
 
         if (type_of(pc) == PAWN)
         {
+            st->pawnKey ^= Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
             st->rule50 = 0;
             if (abs(to - from) == 16)
             {
                 st->epSquare = Square((from + to) / 2);
+                st->key ^= Zobrist::enpassant[file_of(st->epSquare)];
             }
         }
 
+        st->key ^= Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
+        st->psq += Eval::psq[pc][to] - Eval::psq[pc][from];
+        add_dirty(st->dirtyPiece, pc, from, to);
         move_piece(from, to);
     }
     else if (type_of(m) == PROMOTION)
@@ -250,18 +279,38 @@ void Position::do_move(Move m, StateInfo& newSt)
         if (piece_on(to) != NO_PIECE)
         {
             st->capturedPiece = piece_on(to);
+            st->key ^= Zobrist::psq[st->capturedPiece][to];
+            st->psq -= Eval::psq[st->capturedPiece][to];
+            add_dirty(st->dirtyPiece, st->capturedPiece, to, SQ_NONE);
             remove_piece(to);
+            st->materialKey ^= Zobrist::psq[st->capturedPiece][pieceCount[st->capturedPiece]];
         }
 
+        Piece promoted = make_piece(color_of(pc), promotion_type(m));
+
+        st->key ^= Zobrist::psq[pc][from] ^ Zobrist::psq[promoted][to];
+        st->psq += Eval::psq[promoted][to] - Eval::psq[pc][from];
+        add_dirty(st->dirtyPiece, pc, from, SQ_NONE);
+        add_dirty(st->dirtyPiece, promoted, SQ_NONE, to);
+        st->pawnKey ^= Zobrist::psq[pc][from];
         remove_piece(from);
-        put_piece(make_piece(color_of(pc), promotion_type(m)), to);
+        st->materialKey ^= Zobrist::psq[pc][pieceCount[pc]] ^ Zobrist::psq[promoted][pieceCount[promoted]];
+        put_piece(promoted, to);
         st->rule50 = 0;
     }
     else if (type_of(m) == ENPASSANT)
     {
         Square capturedSquare = Square(to - (sideToMove == WHITE ? 8 : -8));
         st->capturedPiece = piece_on(capturedSquare);
+        st->pawnKey ^= Zobrist::psq[st->capturedPiece][capturedSquare]
+            ^ Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
+        st->key ^= Zobrist::psq[st->capturedPiece][capturedSquare]
+            ^ Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
+        st->psq += Eval::psq[pc][to] - Eval::psq[pc][from] - Eval::psq[st->capturedPiece][capturedSquare];
+        add_dirty(st->dirtyPiece, st->capturedPiece, capturedSquare, SQ_NONE);
+        add_dirty(st->dirtyPiece, pc, from, to);
         remove_piece(capturedSquare);
+        st->materialKey ^= Zobrist::psq[st->capturedPiece][pieceCount[st->capturedPiece]];
         move_piece(from, to);
         st->rule50 = 0;
     }
@@ -273,12 +322,22 @@ void Position::do_move(Move m, StateInfo& newSt)
         Square rookTo = to == SQ_G1 ? SQ_F1 : to == SQ_C1 ? SQ_D1 :
             to == SQ_G8 ? SQ_F8 : SQ_D8;
 
+        Piece rook = piece_on(rookFrom);
+
+        st->key ^= Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to]
+            ^ Zobrist::psq[rook][rookFrom] ^ Zobrist::psq[rook][rookTo];
+        st->psq += Eval::psq[pc][to] - Eval::psq[pc][from] + Eval::psq[rook][rookTo] - Eval::psq[rook][rookFrom];
+        add_dirty(st->dirtyPiece, pc, from, to);
+        if (rook != NO_PIECE)
+            add_dirty(st->dirtyPiece, rook, rookFrom, rookTo);
         move_piece(from, to);
         move_piece(rookFrom, rookTo);
     }
 
+    st->key ^= Zobrist::castling[st->castlingRights];
     st->castlingRights &= ~castlingRightsMask[from];
     st->castlingRights &= ~castlingRightsMask[to];
+    st->key ^= Zobrist::castling[st->castlingRights];
 
     sideToMove = Color(~sideToMove);
 
@@ -353,7 +412,18 @@ void Position::do_null_move(StateInfo& newSt)
     sideToMove = Color(~sideToMove);
     st->epSquare = SQ_NONE;
     st->rule50 = 0;
-    st->key = st->previous->key;
+    st->key = st->previous->key ^ Zobrist::side;
+    if (st->previous->epSquare != SQ_NONE)
+        st->key ^= Zobrist::enpassant[file_of(st->previous->epSquare)];
+    st->pawnKey = st->previous->pawnKey;
+    st->materialKey = st->previous->materialKey;
+    st->psq = st->previous->psq;
+    st->npMaterial[WHITE] = st->previous->npMaterial[WHITE];
+    st->npMaterial[BLACK] = st->previous->npMaterial[BLACK];
+    st->castlingRights = st->previous->castlingRights;
+    st->capturedPiece = NO_PIECE;
+    st->dirtyPiece.count = 0;
+    st->accumulator.computed = false;
     st->checkersBB = 0ULL;
     if (count<KING>(WHITE) > 0 && count<KING>(BLACK) > 0)
         st->checkersBB = attackers_to(square<KING>(sideToMove)) & pieces(~sideToMove);
@@ -154,13 +154,13 @@ Key Position::key_after(Move m) const
 
 uint64_t Position::nodes_searched() const
 {
-    return thisThread ? thisThread->nodes : 0;
+    return thisThread ? thisThread->nodes.load(std::memory_order_relaxed) : 0;
 }
 
 void Position::set_nodes_searched(uint64_t n)
 {
     if (thisThread)
-        thisThread->nodes = n;
+        thisThread->nodes.store(n, std::memory_order_relaxed);
 }
 
 bool Position::has_game_cycle(int ply) const
@@ -0,0 +1,593 @@
+#include "cluster.h"
+#include "board.h"
+#include "tt.h"
+#include "uci.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace std;
+
+namespace
+{
+#ifdef _WIN32
+    typedef SOCKET Socket;
+    const Socket NoSocket = INVALID_SOCKET;
+
+    void close_socket(Socket s) { closesocket(s); }
+    int poll_sockets(pollfd* fds, size_t n, int ms) { return WSAPoll(fds, ULONG(n), ms); }
+#else
+    typedef int Socket;
+    const Socket NoSocket = -1;
+
+    void close_socket(Socket s) { ::close(s); }
+    int poll_sockets(pollfd* fds, size_t n, int ms) { return ::poll(fds, nfds_t(n), ms); }
+#endif
+
+    enum MessageType : uint32_t
+    {
+        MsgSearch,  // Root and limits, as text
+        MsgStop,
+        MsgEntries, // Array of Entry
+        MsgResult   // One WireResult
+    };
+
+    struct Header
+    {
+        uint32_t type;
+        uint32_t size;
+    };
+
+    struct Entry
+    {
+        uint64_t key;
+        uint16_t move;
+        int16_t value;
+        int16_t eval;
+        int8_t depth;
+        uint8_t bound;
+    };
+
+    struct WireResult
+    {
+        uint64_t nodes;
+        uint16_t move;
+        int16_t value;
+        int16_t depth;
+    };
+
+    // Larger messages are split by the sender and rejected by the receiver,
+    // so a broken or hostile peer cannot make us buffer without limit
+    const size_t MaxMessageSize = 1 << 20;
+
+    struct Peer
+    {
+        Socket sock;
+        string inbox; // Received bytes not yet making a whole message
+    };
+
+    Socket listener = NoSocket;
+    string unixPath;
+    vector<Peer> peers;
+    mutex peersMutex; // Guards peers and every write to a socket
+
+    thread ioThread;
+    atomic<bool> ioStop(false);
+
+    // Entries waiting to be sent, with the peer they came from so they are
+    // not echoed back to it
+    mutex outMutex;
+    vector<pair<Socket, Entry>> outbox;
+
+    mutex resultMutex;
+    condition_variable resultCv;
+    vector<Cluster::Result> results;
+    size_t expectedResults = 0;
+
+    bool init_sockets()
+    {
+#ifdef _WIN32
+        static bool ready = false;
+        WSADATA data;
+        if (!ready)
+            ready = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        return ready;
+#else
+        return true;
+#endif
+    }
+
+    // Listens on or connects to "unix:<path>" or "host:port"
+    Socket open_socket(const string& address, bool server)
+    {
+        if (!init_sockets())
+            return NoSocket;
+
+#ifndef _WIN32
+        if (address.compare(0, 5, "unix:") == 0)
+        {
+            sockaddr_un sa = {};
+            string path = address.substr(5);
+            if (path.empty() || path.size() >= sizeof(sa.sun_path))
+                return NoSocket;
+
+            sa.sun_family = AF_UNIX;
+            strcpy(sa.sun_path, path.c_str());
+
+            Socket s = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (s == NoSocket)
+                return NoSocket;
+
+            if (server)
+            {
+                unlink(path.c_str());
+                if (bind(s, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0 || ::listen(s, 16) != 0)
+                {
+                    close_socket(s);
+                    return NoSocket;
+                }
+                unixPath = path;
+            }
+            else if (connect(s, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0)
+            {
+                close_socket(s);
+                return NoSocket;
+            }
+
+            return s;
+        }
+#endif
+        size_t colon = address.rfind(':');
+        if (colon == string::npos)
+            return NoSocket;
+
+        string host = address.substr(0, colon), port = address.substr(colon + 1);
+        addrinfo hints = {}, *info;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = server ? AI_PASSIVE : 0;
+
+        if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info) != 0)
+            return NoSocket;
+
+        Socket s = NoSocket;
+        for (addrinfo* ai = info; ai && s == NoSocket; ai = ai->ai_next)
+        {
+            s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (s == NoSocket)
+                continue;
+
+            int one = 1;
+            bool ok = server
+                ? setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one)) == 0
+                  && bind(s, ai->ai_addr, int(ai->ai_addrlen)) == 0 && ::listen(s, 16) == 0
+                : connect(s, ai->ai_addr, int(ai->ai_addrlen)) == 0;
+
+            if (!ok)
+            {
+                close_socket(s);
+                s = NoSocket;
+            }
+        }
+
+        freeaddrinfo(info);
+        return s;
+    }
+
+    bool send_all(Socket s, const char* data, size_t len)
+    {
+        while (len)
+        {
+            int n = int(send(s, data, int(std::min(len, size_t(1) << 20)), MSG_NOSIGNAL));
+            if (n <= 0)
+                return false;
+            data += n;
+            len -= size_t(n);
+        }
+        return true;
+    }
+
+    // Callers hold peersMutex
+    bool send_message(Socket s, MessageType type, const string& payload)
+    {
+        Header h = { type, uint32_t(payload.size()) };
+        return send_all(s, reinterpret_cast<const char*>(&h), sizeof(h))
+            && send_all(s, payload.data(), payload.size());
+    }
+
+    bool valid(const Header& h)
+    {
+        switch (h.type)
+        {
+        case MsgSearch: return h.size <= MaxMessageSize;
+        case MsgStop:   return h.size == 0;
+        case MsgEntries: return h.size <= MaxMessageSize && h.size % sizeof(Entry) == 0;
+        case MsgResult: return h.size == sizeof(WireResult);
+        default:        return false;
+        }
+    }
+
+    // Reads what is available and splits off the complete messages. Returns
+    // false once the other end has gone or sent a malformed header, after
+    // which the peer is dropped.
+    bool receive(Peer& peer, vector<pair<uint32_t, string>>& messages)
+    {
+        char buffer[1 << 16];
+        int n = int(recv(peer.sock, buffer, sizeof(buffer), 0));
+        if (n <= 0)
+            return false;
+
+        peer.inbox.append(buffer, size_t(n));
+
+        while (peer.inbox.size() >= sizeof(Header))
+        {
+            Header h;
+            memcpy(&h, peer.inbox.data(), sizeof(h));
+            if (!valid(h))
+                return false;
+            if (peer.inbox.size() < sizeof(h) + h.size)
+                break;
+
+            messages.emplace_back(h.type, peer.inbox.substr(sizeof(h), h.size));
+            peer.inbox.erase(0, sizeof(h) + h.size);
+        }
+
+        return true;
+    }
+
+    void store(const Entry& e)
+    {
+        bool found;
+        TTEntry* tte = TT.probe(e.key, found, Depth(e.depth));
+        tte->save(e.key, Value(e.value), false, Bound(e.bound), Depth(e.depth), Move(e.move), Value(e.eval));
+    }
+
+    // Stores received entries. The coordinator also passes them on to the
+    // other workers.
+    void receive_entries(Socket origin, const string& payload, bool relay)
+    {
+        size_t count = payload.size() / sizeof(Entry);
+        vector<Entry> entries(count);
+        if (count)
+            memcpy(entries.data(), payload.data(), count * sizeof(Entry));
+
+        for (const Entry& e : entries)
+            store(e);
+
+        if (!relay)
+            return;
+
+        lock_guard<mutex> lock(outMutex);
+        for (const Entry& e : entries)
+            outbox.emplace_back(origin, e);
+    }
+
+    void flush()
+    {
+        vector<pair<Socket, Entry>> pending;
+        {
+            lock_guard<mutex> lock(outMutex);
+            pending.swap(outbox);
+        }
+
+        if (pending.empty())
+            return;
+
+        lock_guard<mutex> lock(peersMutex);
+        for (const Peer& peer : peers)
+        {
+            string payload;
+            for (const auto& p : pending)
+                if (p.first != peer.sock)
+                {
+                    payload.append(reinterpret_cast<const char*>(&p.second), sizeof(Entry));
+
+                    if (payload.size() + sizeof(Entry) > MaxMessageSize)
+                    {
+                        send_message(peer.sock, MsgEntries, payload);
+                        payload.clear();
+                    }
+                }
+
+            if (!payload.empty())
+                send_message(peer.sock, MsgEntries, payload);
+        }
+    }
+
+    void drop_peer(size_t i)
+    {
+        {
+            lock_guard<mutex> lock(peersMutex);
+            close_socket(peers[i].sock);
+            peers.erase(peers.begin() + i);
+            Cluster::active = !peers.empty();
+        }
+
+        // A worker that is gone will not report
+        lock_guard<mutex> lock(resultMutex);
+        if (expectedResults)
+            --expectedResults;
+        resultCv.notify_all();
+    }
+
+    // Coordinator I/O: accepts workers, takes in their entries and results,
+    // and passes entries on every 10ms.
+    void serve()
+    {
+        while (!ioStop)
+        {
+            vector<pollfd> fds(1);
+            fds[0].fd = listener;
+            fds[0].events = POLLIN;
+            {
+                lock_guard<mutex> lock(peersMutex);
+                for (const Peer& peer : peers)
+                    fds.push_back({ peer.sock, POLLIN, 0 });
+            }
+
+            if (poll_sockets(fds.data(), fds.size(), 10) > 0)
+            {
+                // Peers are only added and dropped on this thread, so fds
+                // and peers stay in step until the accept below.
+                for (size_t i = fds.size() - 1; i > 0; --i)
+                {
+                    if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                        continue;
+
+                    vector<pair<uint32_t, string>> messages;
+                    if (!receive(peers[i - 1], messages))
+                    {
+                        drop_peer(i - 1);
+                        cout << "info string Cluster worker left, " << Cluster::workers() << " connected" << endl;
+                        continue;
+                    }
+
+                    for (const auto& msg : messages)
+                        if (msg.first == MsgEntries)
+                            receive_entries(fds[i].fd, msg.second, true);
+                        else if (msg.first == MsgResult && msg.second.size() == sizeof(WireResult))
+                        {
+                            WireResult r;
+                            memcpy(&r, msg.second.data(), sizeof(r));
+
+                            lock_guard<mutex> lock(resultMutex);
+                            results.push_back({ Move(r.move), Value(r.value), Depth(r.depth), r.nodes });
+                            resultCv.notify_all();
+                        }
+                }
+
+                if (fds[0].revents & POLLIN)
+                {
+                    Socket s = accept(listener, nullptr, nullptr);
+                    if (s != NoSocket)
+                    {
+                        lock_guard<mutex> lock(peersMutex);
+                        peers.push_back({ s, string() });
+                        Cluster::active = true;
+                        cout << "info string Cluster worker joined, " << peers.size() << " connected" << endl;
+                    }
+                }
+            }
+
+            flush();
+        }
+    }
+}
+
+namespace Cluster
+{
+    int ShareDepth = 8;
+    std::atomic<bool> active(false);
+
+    bool listen(const string& address)
+    {
+        close();
+
+        listener = open_socket(address, true);
+        if (listener == NoSocket)
+            return false;
+
+        ioStop = false;
+        ioThread = thread(serve);
+        return true;
+    }
+
+    void close()
+    {
+        if (ioThread.joinable())
+        {
+            ioStop = true;
+            ioThread.join();
+        }
+
+        lock_guard<mutex> lock(peersMutex);
+        for (const Peer& peer : peers)
+            close_socket(peer.sock);
+        peers.clear();
+        active = false;
+
+        if (listener != NoSocket)
+            close_socket(listener);
+        listener = NoSocket;
+
+#ifndef _WIN32
+        if (!unixPath.empty())
+            unlink(unixPath.c_str());
+#endif
+        unixPath.clear();
+    }
+
+    size_t workers()
+    {
+        lock_guard<mutex> lock(peersMutex);
+        return listener != NoSocket ? peers.size() : 0;
+    }
+
+    // Workers search until told to stop: the coordinator owns the clock.
+    // Only a depth limit and searchmoves are passed on.
+    void start_search(const Position& pos, const Search::Limits& limits)
+    {
+        lock_guard<mutex> lock(peersMutex);
+        if (listener == NoSocket || peers.empty())
+            return;
+
+        ostringstream ss;
+        ss << pos.fen() << "\n" << "depth " << limits.depth;
+        for (Move m : limits.searchmoves)
+            ss << " searchmoves " << UCI::move(m, pos.is_chess960());
+
+        {
+            lock_guard<mutex> lockResults(resultMutex);
+            results.clear();
+            expectedResults = 0;
+        }
+
+        for (const Peer& peer : peers)
+            if (send_message(peer.sock, MsgSearch, ss.str()))
+            {
+                lock_guard<mutex> lockResults(resultMutex);
+                ++expectedResults;
+            }
+    }
+
+    vector<Result> stop_search()
+    {
+        {
+            lock_guard<mutex> lock(peersMutex);
+            if (listener == NoSocket)
+                return vector<Result>();
+
+            for (const Peer& peer : peers)
+                send_message(peer.sock, MsgStop, string());
+        }
+
+        unique_lock<mutex> lock(resultMutex);
+        resultCv.wait_for(lock, chrono::seconds(2), [] { return results.size() >= expectedResults; });
+        expectedResults = 0;
+
+        vector<Result> r;
+        r.swap(results);
+        return r;
+    }
+
+    void share(Key key, Value v, Bound b, Depth d, Move m, Value ev)
+    {
+        Entry e = { key, uint16_t(m), int16_t(v), int16_t(ev), int8_t(d), uint8_t(b) };
+
+        lock_guard<mutex> lock(outMutex);
+        outbox.emplace_back(NoSocket, e);
+    }
+
+    void run_worker(const string& address)
+    {
+        Socket s = NoSocket;
+        for (int attempt = 0; attempt < 50 && s == NoSocket; ++attempt)
+            if ((s = open_socket(address, false)) == NoSocket)
+                this_thread::sleep_for(chrono::milliseconds(100));
+
+        if (s == NoSocket)
+        {
+            cout << "info string Could not connect to " << address << endl;
+            return;
+        }
+
+        {
+            lock_guard<mutex> lock(peersMutex);
+            peers.push_back({ s, string() });
+        }
+        active = true;
+        cout << "info string Cluster worker connected to " << address << endl;
+
+        Position pos;
+        StateInfo st;
+
+        while (true)
+        {
+            pollfd fd = { s, POLLIN, 0 };
+            vector<pair<uint32_t, string>> messages;
+
+            if (poll_sockets(&fd, 1, 10) > 0 && !receive(peers[0], messages))
+                break;
+
+            for (const auto& msg : messages)
+            {
+                if (msg.first == MsgEntries)
+                    receive_entries(s, msg.second, false);
+
+                else if (msg.first == MsgSearch)
+                {
+                    Search::stop();
+                    Search::wait();
+
+                    istringstream is(msg.second);
+                    string fen, token;
+                    getline(is, fen);
+                    pos.set(fen, false, &st, Threads);
+
+                    Search::Limits limits;
+                    limits.infinite = 1;
+                    while (is >> token)
+                        if (token == "depth")
+                            is >> limits.depth;
+                        else if (token == "searchmoves" && is >> token)
+                            limits.searchmoves.push_back(UCI::to_move(pos, token));
+
+                    Search::go(pos, limits, false);
+                }
+
+                else if (msg.first == MsgStop)
+                {
+                    Search::stop();
+                    Search::wait();
+
+                    WireResult r = { Search::nodes_searched(), uint16_t(Threads->bestMove),
+                        int16_t(Threads->bestValue), int16_t(Threads->completedDepth) };
+
+                    lock_guard<mutex> lock(peersMutex);
+                    send_message(s, MsgResult, string(reinterpret_cast<const char*>(&r), sizeof(r)));
+                }
+            }
+
+            flush();
+        }
+
+        Search::stop();
+        Search::wait();
+        active = false;
+        {
+            lock_guard<mutex> lock(peersMutex);
+            peers.clear();
+        }
+        {
+            lock_guard<mutex> lock(outMutex);
+            outbox.clear();
+        }
+        close_socket(s);
+        cout << "info string Coordinator closed the connection" << endl;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "types.h"
+#include "search.h"
+#include "tt.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+class Position;
+
+// Several Zorn processes searching one position together, Lazy SMP style.
+// The coordinator is the process driven over UCI; it listens on an address,
+// "host:port" for TCP or "unix:<path>", and worker processes started with
+// "clusterworker <address>" connect to it. On go the coordinator sends the
+// root and limits to every worker, all of them search with their own TT and
+// exchange deep entries, and on stop the workers' results join the thread
+// vote. Messages are sent in host byte order, so all hosts must agree on it.
+namespace Cluster
+{
+    struct Result
+    {
+        Move move;
+        Value value;
+        Depth depth;
+        uint64_t nodes;
+    };
+
+    // Entries saved at this depth or more are sent to the other processes
+    extern int ShareDepth;
+
+    // True while connected as a worker or while any worker is connected, so
+    // search can skip share() with a single load otherwise
+    extern std::atomic<bool> active;
+
+    bool listen(const std::string& address);
+    void close();
+    size_t workers();
+
+    // Coordinator side of Search::start
+    void start_search(const Position& pos, const Search::Limits& limits);
+    std::vector<Result> stop_search();
+
+    // Queues a TT entry for the other processes. v is as stored in the TT.
+    void share(Key key, Value v, Bound b, Depth d, Move m, Value ev);
+
+    // clusterworker: serves searches for the coordinator until it hangs up
+    void run_worker(const std::string& address);
+}
+
+#endif
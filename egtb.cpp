@@ -0,0 +1,773 @@
+#include "egtb.h"
+#include "board.h"
+#include "bitboard.h"
+#include "move.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    using namespace EGTB;
+
+    // Stored bytes, from the side to move's point of view. A win in p plies
+    // (p odd) is (p + 1) / 2, a loss in p plies (p even) LossBase + p / 2.
+    enum : uint8_t { DRAW = 0, LossBase = 128, INVALID = 254, UNKNOWN = 255 };
+
+    constexpr int MaxPlies = 250;
+
+    inline uint8_t win_in(int plies) { return uint8_t((plies + 1) / 2); }
+    inline uint8_t loss_in(int plies) { return uint8_t(LossBase + plies / 2); }
+    inline bool is_win(uint8_t b) { return b != DRAW && b < LossBase; }
+    inline bool is_loss(uint8_t b) { return b >= LossBase && b < INVALID; }
+    inline int plies_of(uint8_t b) { return is_win(b) ? 2 * b - 1 : 2 * (b - LossBase); }
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t entries;
+    };
+
+    const char Magic[4] = { 'Z', 'D', 'T', 'M' };
+    const uint32_t Version = 1;
+
+    // Squares the white king is mirrored into: the a1-d1-d4 triangle without
+    // pawns, files a-d with them.
+    int Region[2][SQUARE_NB];
+    int RegionSquare[2][32];
+    const int RegionSize[2] = { 10, 32 };
+
+    // The 8 board symmetries: bit 0 mirrors files, bit 1 ranks, bit 2 swaps
+    // the two. Only the first two keep pawns moving the same way.
+    inline int transform(int s, int t)
+    {
+        int f = s & 7, r = s >> 3;
+        if (t & 1) f = 7 - f;
+        if (t & 2) r = 7 - r;
+        if (t & 4) std::swap(f, r);
+        return r * 8 + f;
+    }
+
+    // An ending such as KRPvKN. Its pieces are in table colours, White being
+    // the side named first: White's king, White's other pieces, then the
+    // same for Black, with identical pieces adjacent. key is the material
+    // key in table colours and key2 the one with colours swapped.
+    struct Table
+    {
+        explicit Table(const std::string& code);
+        ~Table();
+
+        std::string code;
+        Key key, key2;
+        int pieceCount;
+        Piece pieces[MaxPieces];
+        bool hasPawns;
+        uint64_t entries;
+
+        const uint8_t* data = nullptr;
+        void* base = nullptr;
+        size_t size = 0;
+        void* handle = nullptr;
+    };
+
+    std::deque<Table> Tables;
+    std::unordered_map<Key, Table*> Lookup;
+
+    Table::Table(const std::string& c) : code(c)
+    {
+        StateInfo st;
+        Position pos;
+
+        key = pos.set(code, WHITE, &st).material_key();
+        key2 = pos.set(code, BLACK, &st).material_key();
+
+        const std::string PieceChars = " PNBRQK";
+        pieceCount = 0;
+        hasPawns = false;
+
+        for (Color side = WHITE; side <= BLACK; ++side)
+        {
+            std::string s = side == WHITE ? code.substr(0, code.find('v')) : code.substr(code.find('v') + 1);
+            for (char ch : s)
+            {
+                PieceType pt = PieceType(PieceChars.find(ch));
+                pieces[pieceCount++] = make_piece(side, pt);
+                hasPawns |= pt == PAWN;
+            }
+        }
+
+        entries = 2 * uint64_t(RegionSize[hasPawns]);
+        for (int i = 1; i < pieceCount; ++i)
+            entries *= 64;
+    }
+
+    Table::~Table()
+    {
+        if (!base)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(static_cast<HANDLE>(handle));
+#else
+        munmap(base, size);
+#endif
+    }
+
+    bool map_file(Table& t, const std::string& path)
+    {
+#ifdef _WIN32
+        HANDLE fd = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (fd == INVALID_HANDLE_VALUE)
+            return false;
+
+        DWORD high;
+        DWORD low = GetFileSize(fd, &high);
+        t.size = size_t((uint64_t(high) << 32) | low);
+        HANDLE mapping = t.size ? CreateFileMappingA(fd, nullptr, PAGE_READONLY, high, low, nullptr) : nullptr;
+        CloseHandle(fd);
+        if (!mapping)
+            return false;
+
+        t.base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!t.base)
+        {
+            CloseHandle(mapping);
+            return false;
+        }
+        t.handle = mapping;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        t.size = size_t(st.st_size);
+        t.base = mmap(nullptr, t.size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (t.base == MAP_FAILED)
+        {
+            t.base = nullptr;
+            return false;
+        }
+#endif
+        const Header* h = static_cast<const Header*>(t.base);
+
+        if (t.size == sizeof(Header) + t.entries
+            && std::memcmp(h->magic, Magic, 4) == 0
+            && h->version == Version
+            && h->entries == t.entries)
+        {
+            t.data = static_cast<const uint8_t*>(t.base) + sizeof(Header);
+            return true;
+        }
+
+        std::cout << "info string Ignoring malformed table " << path << std::endl;
+        return false;
+    }
+
+    // Index of a position given in table colours, sq listing the square of
+    // each of t.pieces. Of the symmetric images with the white king in its
+    // region the smallest index is taken, identical pieces being sorted.
+    uint64_t encode(const Table& t, Color stm, const int* sq)
+    {
+        uint64_t best = ~uint64_t(0);
+        int tsq[MaxPieces];
+
+        for (int tr = 0; tr < (t.hasPawns ? 2 : 8); ++tr)
+        {
+            int r = Region[t.hasPawns][transform(sq[0], tr)];
+            if (r < 0)
+                continue;
+
+            for (int i = 1; i < t.pieceCount; ++i)
+            {
+                tsq[i] = transform(sq[i], tr);
+                for (int j = i; j > 1 && t.pieces[j] == t.pieces[j - 1] && tsq[j] < tsq[j - 1]; --j)
+                    std::swap(tsq[j], tsq[j - 1]);
+            }
+
+            uint64_t idx = uint64_t(stm) * RegionSize[t.hasPawns] + r;
+            for (int i = 1; i < t.pieceCount; ++i)
+                idx = idx * 64 + tsq[i];
+
+            best = std::min(best, idx);
+        }
+
+        return best;
+    }
+
+    void decode(const Table& t, uint64_t idx, Color& stm, int* sq)
+    {
+        for (int i = t.pieceCount - 1; i > 0; --i, idx /= 64)
+            sq[i] = int(idx % 64);
+
+        sq[0] = RegionSquare[t.hasPawns][idx % RegionSize[t.hasPawns]];
+        stm = Color(idx / RegionSize[t.hasPawns]);
+    }
+
+    // Brings the position to table colours and returns its entry
+    bool lookup(const Position& pos, uint8_t& b)
+    {
+        auto it = Lookup.find(pos.material_key());
+        if (it == Lookup.end())
+            return false;
+
+        const Table& t = *it->second;
+        bool flip = pos.material_key() != t.key;
+        int sq[MaxPieces];
+
+        for (int i = 0; i < t.pieceCount; )
+        {
+            Bitboard bb = pos.pieces(Color(color_of(t.pieces[i]) ^ flip), type_of(t.pieces[i]));
+            while (bb)
+                sq[i++] = pop_lsb(bb) ^ (flip ? 56 : 0);
+        }
+
+        b = t.data[encode(t, Color(pos.side_to_move() ^ flip), sq)];
+        return true;
+    }
+
+    bool covered(const Position& pos)
+    {
+        return !Lookup.empty()
+            && popcount(pos.pieces()) <= MaxPieces
+            && pos.ep_square() == SQ_NONE
+            && !pos.can_castle(ANY_CASTLING);
+    }
+
+    std::string fen(const Table& t, Color stm, const int* sq)
+    {
+        const char PieceChars[] = " PNBRQK  pnbrqk";
+        char board[SQUARE_NB] = {};
+
+        for (int i = 0; i < t.pieceCount; ++i)
+            board[sq[i]] = PieceChars[t.pieces[i]];
+
+        std::string s;
+        for (int r = 7; r >= 0; --r)
+        {
+            int empty = 0;
+            for (int f = 0; f < 8; ++f)
+            {
+                char c = board[r * 8 + f];
+                if (!c)
+                    ++empty;
+                else
+                {
+                    if (empty)
+                        s += char('0' + empty);
+                    empty = 0;
+                    s += c;
+                }
+            }
+            if (empty)
+                s += char('0' + empty);
+            if (r)
+                s += '/';
+        }
+
+        return s + (stm == WHITE ? " w - - 0 1" : " b - - 0 1");
+    }
+
+    // Runs fn(begin, end) over [0, n) in chunks taken by the given number
+    // of threads.
+    template<typename Fn>
+    void parallel_for(uint64_t n, int threads, Fn fn)
+    {
+        const uint64_t Chunk = 1 << 16;
+        std::atomic<uint64_t> next(0);
+        auto worker = [&]() {
+            for (uint64_t begin; (begin = next.fetch_add(Chunk)) < n; )
+                fn(begin, std::min(n, begin + Chunk));
+        };
+
+        std::vector<std::thread> pool;
+        for (int i = 1; i < threads; ++i)
+            pool.emplace_back(worker);
+        worker();
+        for (std::thread& th : pool)
+            th.join();
+    }
+
+    void update_max(std::atomic<int>& m, int v)
+    {
+        int cur = m.load();
+        while (v > cur && !m.compare_exchange_weak(cur, v)) {}
+    }
+
+    // One table under construction. Values are settled level by level: at
+    // an even level L the positions lost in L plies make every predecessor
+    // a win in L + 1; at an odd level the predecessors of positions won in
+    // L plies are checked, and those whose every move now reaches a win for
+    // the opponent become losses. Captures and promotions leave the table;
+    // their results are read from the smaller tables up front.
+    class Generator
+    {
+    public:
+        Generator(Table& t, int threads) : t(t), threads(threads), n(t.entries),
+            value(new std::atomic<uint8_t>[n]), exitWin(n, 0), exitLoss(n, 0), drawExit(n, 0) {}
+
+        bool run();
+        void write(std::ostream& out) const;
+        int levels() const { return maxLevel.load(); }
+
+    private:
+        void classify(uint64_t idx, Position& pos);
+        void settle(uint64_t idx, int level);
+        bool all_moves_lose(uint64_t idx, int& maxPlies) const;
+
+        void set(uint64_t idx, uint8_t v, int plies)
+        {
+            uint8_t expected = UNKNOWN;
+            if (value[idx].compare_exchange_strong(expected, v))
+                update_max(maxLevel, plies);
+        }
+
+        Table& t;
+        int threads;
+        uint64_t n;
+        std::unique_ptr<std::atomic<uint8_t>[]> value;
+        std::vector<uint8_t> exitWin;  // Fastest win through a capture or promotion, 0 if none
+        std::vector<uint8_t> exitLoss; // Slowest loss through one
+        std::vector<uint8_t> drawExit; // Some capture or promotion draws
+        std::atomic<int> maxLevel{ 0 };
+        std::atomic<bool> failed{ false };
+    };
+
+    // First pass: legality, mates, and the results of leaving the table
+    void Generator::classify(uint64_t idx, Position& pos)
+    {
+        Color stm;
+        int sq[MaxPieces];
+        decode(t, idx, stm, sq);
+
+        Bitboard occupied = 0;
+        for (int i = 0; i < t.pieceCount; ++i)
+        {
+            if ((occupied & square_bb(Square(sq[i])))
+                || (type_of(t.pieces[i]) == PAWN && (sq[i] < 8 || sq[i] >= 56)))
+            {
+                value[idx] = INVALID;
+                return;
+            }
+            occupied |= square_bb(Square(sq[i]));
+        }
+
+        if (encode(t, stm, sq) != idx)
+        {
+            value[idx] = INVALID;
+            return;
+        }
+
+        StateInfo st;
+        pos.set(fen(t, stm, sq), false, &st, nullptr);
+
+        if (pos.attackers_to(pos.square<KING>(~stm)) & pos.pieces(stm))
+        {
+            value[idx] = INVALID;
+            return;
+        }
+
+        int legal = 0, quiet = 0, fastestWin = 0, slowestLoss = 0;
+        bool draws = false;
+
+        for (const auto& m : MoveList(pos))
+        {
+            if (!pos.legal(m))
+                continue;
+
+            ++legal;
+
+            if (pos.piece_on(to_sq(m)) == NO_PIECE && type_of(m) == NORMAL)
+            {
+                ++quiet;
+                continue;
+            }
+
+            StateInfo st2;
+            uint8_t b = DRAW;
+            pos.do_move(m, st2);
+            bool found = popcount(pos.pieces()) == 2 || lookup(pos, b);
+            pos.undo_move(m);
+
+            if (!found)
+            {
+                failed = true;
+                return;
+            }
+
+            if (is_loss(b))
+                fastestWin = fastestWin ? std::min(fastestWin, plies_of(b) + 1) : plies_of(b) + 1;
+            else if (is_win(b))
+                slowestLoss = std::max(slowestLoss, plies_of(b) + 1);
+            else
+                draws = true;
+        }
+
+        if (!legal)
+            value[idx] = pos.checkers() ? loss_in(0) : uint8_t(DRAW);
+
+        else if (!quiet)
+        {
+            int plies = fastestWin ? fastestWin : slowestLoss;
+            value[idx] = fastestWin ? win_in(fastestWin) : draws ? uint8_t(DRAW) : loss_in(slowestLoss);
+            update_max(maxLevel, plies);
+        }
+        else
+        {
+            value[idx] = UNKNOWN;
+            exitWin[idx] = uint8_t(fastestWin);
+            exitLoss[idx] = uint8_t(slowestLoss);
+            drawExit[idx] = draws;
+            update_max(maxLevel, fastestWin);
+        }
+    }
+
+    // Calls fn(predecessor index) for each position from which the side not
+    // to move reached this one without capturing or promoting.
+    template<typename Fn>
+    void for_each_predecessor(const Table& t, Color stm, int* sq, Fn fn)
+    {
+        Bitboard occupied = 0;
+        for (int i = 0; i < t.pieceCount; ++i)
+            occupied |= square_bb(Square(sq[i]));
+
+        Color mover = ~stm;
+
+        for (int i = 0; i < t.pieceCount; ++i)
+        {
+            if (color_of(t.pieces[i]) != mover)
+                continue;
+
+            int s = sq[i];
+            Bitboard from;
+
+            if (type_of(t.pieces[i]) == PAWN)
+            {
+                int back = mover == WHITE ? -8 : 8;
+                from = 0;
+                if (relative_rank(mover, Square(s)) > RANK_2 && !(occupied & square_bb(Square(s + back))))
+                {
+                    from |= square_bb(Square(s + back));
+                    if (relative_rank(mover, Square(s)) == RANK_4 && !(occupied & square_bb(Square(s + 2 * back))))
+                        from |= square_bb(Square(s + 2 * back));
+                }
+            }
+            else
+                from = attacks_bb(type_of(t.pieces[i]), Square(s), occupied) & ~occupied;
+
+            while (from)
+            {
+                sq[i] = pop_lsb(from);
+                fn(encode(t, mover, sq));
+            }
+            sq[i] = s;
+        }
+    }
+
+    // Whether every quiet move of the (unsettled) position reaches a
+    // settled win for the opponent; maxPlies is then the slowest of them.
+    bool Generator::all_moves_lose(uint64_t idx, int& maxPlies) const
+    {
+        Color stm;
+        int sq[MaxPieces];
+        decode(t, idx, stm, sq);
+
+        Bitboard occupied = 0;
+        for (int i = 0; i < t.pieceCount; ++i)
+            occupied |= square_bb(Square(sq[i]));
+
+        maxPlies = exitLoss[idx] ? exitLoss[idx] - 1 : 0;
+
+        for (int i = 0; i < t.pieceCount; ++i)
+        {
+            if (color_of(t.pieces[i]) != stm)
+                continue;
+
+            int s = sq[i];
+            Bitboard to;
+
+            if (type_of(t.pieces[i]) == PAWN)
+            {
+                int push = stm == WHITE ? 8 : -8;
+                to = 0;
+                if (relative_rank(stm, Square(s)) < RANK_7 && !(occupied & square_bb(Square(s + push))))
+                {
+                    to |= square_bb(Square(s + push));
+                    if (relative_rank(stm, Square(s)) == RANK_2 && !(occupied & square_bb(Square(s + 2 * push))))
+                        to |= square_bb(Square(s + 2 * push));
+                }
+            }
+            else
+                to = attacks_bb(type_of(t.pieces[i]), Square(s), occupied) & ~occupied;
+
+            while (to)
+            {
+                sq[i] = pop_lsb(to);
+                uint8_t b = value[encode(t, ~stm, sq)];
+                sq[i] = s;
+
+                if (b == INVALID)
+                    continue;
+                if (!is_win(b))
+                    return false;
+
+                maxPlies = std::max(maxPlies, plies_of(b));
+            }
+        }
+
+        return true;
+    }
+
+    void Generator::settle(uint64_t idx, int level)
+    {
+        Color stm;
+        int sq[MaxPieces];
+        decode(t, idx, stm, sq);
+
+        if (level % 2 == 0)
+            for_each_predecessor(t, stm, sq, [&](uint64_t p) {
+                if (value[p] == UNKNOWN)
+                    set(p, win_in(level + 1), level + 1);
+            });
+        else
+            for_each_predecessor(t, stm, sq, [&](uint64_t p) {
+                int maxPlies;
+                if (value[p] == UNKNOWN && !exitWin[p] && !drawExit[p] && all_moves_lose(p, maxPlies))
+                    set(p, loss_in(maxPlies + 1), maxPlies + 1);
+            });
+    }
+
+    bool Generator::run()
+    {
+        parallel_for(n, threads, [&](uint64_t begin, uint64_t end) {
+            Position pos;
+            for (uint64_t idx = begin; idx < end && !failed; ++idx)
+                classify(idx, pos);
+        });
+
+        if (failed)
+            return false;
+
+        for (int level = 0; level <= maxLevel; ++level)
+        {
+            if (level > MaxPlies)
+                return false;
+
+            const uint8_t target = level % 2 ? win_in(level) : loss_in(level);
+
+            parallel_for(n, threads, [&](uint64_t begin, uint64_t end) {
+                for (uint64_t idx = begin; idx < end; ++idx)
+                {
+                    // A capture or promotion win stands unless a quiet
+                    // move won sooner.
+                    if (level % 2 && exitWin[idx] == level)
+                    {
+                        uint8_t expected = UNKNOWN;
+                        value[idx].compare_exchange_strong(expected, target);
+                    }
+
+                    if (value[idx] == target)
+                        settle(idx, level);
+                }
+            });
+        }
+
+        return true;
+    }
+
+    void Generator::write(std::ostream& out) const
+    {
+        Header h;
+        std::memcpy(h.magic, Magic, 4);
+        h.version = Version;
+        h.entries = n;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+        // Whatever is still unsettled can never be forced either way
+        std::vector<char> buffer(1 << 20);
+        for (uint64_t idx = 0; idx < n; )
+        {
+            size_t len = 0;
+            for (; len < buffer.size() && idx < n; ++len, ++idx)
+            {
+                uint8_t v = value[idx];
+                buffer[len] = char(v == UNKNOWN ? uint8_t(DRAW) : v);
+            }
+            out.write(buffer.data(), std::streamsize(len));
+        }
+    }
+
+    // All 3- and 4-man endings, the stronger side first, in an order where
+    // every capture or promotion leads to an earlier one.
+    std::vector<std::string> endings()
+    {
+        const std::string Pieces = "QRBNP";
+        std::vector<std::string> codes;
+
+        for (char a : Pieces)
+            codes.push_back(std::string("K") + a + "vK");
+
+        for (size_t i = 0; i < Pieces.size(); ++i)
+            for (size_t j = i; j < Pieces.size(); ++j)
+            {
+                codes.push_back(std::string("K") + Pieces[i] + Pieces[j] + "vK");
+                codes.push_back(std::string("K") + Pieces[i] + "vK" + Pieces[j]);
+            }
+
+        auto rank = [](const std::string& c) {
+            return int(c.size()) * 8 + int(std::count(c.begin(), c.end(), 'P'));
+        };
+        std::stable_sort(codes.begin(), codes.end(),
+            [&](const std::string& a, const std::string& b) { return rank(a) < rank(b); });
+
+        return codes;
+    }
+
+    void init_regions()
+    {
+        std::fill(&Region[0][0], &Region[0][0] + 2 * SQUARE_NB, -1);
+
+        int n[2] = {};
+        for (int s = 0; s < SQUARE_NB; ++s)
+        {
+            int f = s & 7, r = s >> 3;
+            if (f <= 3 && r <= f)
+                RegionSquare[0][n[0]] = s, Region[0][s] = n[0]++;
+            if (f <= 3)
+                RegionSquare[1][n[1]] = s, Region[1][s] = n[1]++;
+        }
+    }
+
+    void add(const std::string& code, const std::string& dir)
+    {
+        Tables.emplace_back(code);
+        Table& t = Tables.back();
+
+        if (!map_file(t, dir + "/" + code + ".zdtm"))
+        {
+            Tables.pop_back();
+            return;
+        }
+
+        Lookup[t.key] = &t;
+        Lookup[t.key2] = &t;
+    }
+}
+
+namespace EGTB
+{
+    void init(const std::string& dir)
+    {
+        static bool regionsReady = false;
+        if (!regionsReady)
+        {
+            init_regions();
+            regionsReady = true;
+        }
+
+        Lookup.clear();
+        Tables.clear();
+
+        if (dir.empty() || dir == "<empty>")
+            return;
+
+        for (const std::string& code : endings())
+            add(code, dir);
+
+        std::cout << "info string Found " << Tables.size() << " DTM tables" << std::endl;
+    }
+
+    void generate(const std::string& dir, int threads)
+    {
+        init(dir);
+        threads = std::max(threads, 1);
+
+        for (const std::string& code : endings())
+        {
+            Table t(code);
+            if (Lookup.count(t.key))
+                continue;
+
+            auto start = std::chrono::steady_clock::now();
+            Generator gen(t, threads);
+
+            if (!gen.run())
+            {
+                std::cout << "info string Could not generate " << code << std::endl;
+                break;
+            }
+
+            std::string path = dir + "/" + code + ".zdtm";
+            {
+                std::ofstream out(path, std::ios::binary);
+                gen.write(out);
+                if (!out)
+                {
+                    std::cout << "info string Could not write " << path << std::endl;
+                    break;
+                }
+            }
+
+            add(code, dir);
+
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "info string Generated " << code << " longest mate " << gen.levels()
+                << " plies time " << ms << "ms" << std::endl;
+        }
+
+        init(dir);
+    }
+
+    bool probe(const Position& pos, int ply, Value& v)
+    {
+        uint8_t b = DRAW;
+
+        if (!covered(pos) || (popcount(pos.pieces()) > 2 && !lookup(pos, b)))
+            return false;
+
+        v = is_win(b) ? Value(VALUE_MATE - ply - plies_of(b))
+            : is_loss(b) ? Value(-VALUE_MATE + ply + plies_of(b)) : VALUE_DRAW;
+        return true;
+    }
+
+    bool probe_eval(const Position& pos, Value& v)
+    {
+        uint8_t b = DRAW;
+
+        if (!covered(pos) || (popcount(pos.pieces()) > 2 && !lookup(pos, b)))
+            return false;
+
+        v = is_win(b) ? Value(VALUE_KNOWN_WIN - plies_of(b))
+            : is_loss(b) ? Value(-VALUE_KNOWN_WIN + plies_of(b)) : VALUE_DRAW;
+        return true;
+    }
+}
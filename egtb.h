@@ -0,0 +1,35 @@
+#ifndef EGTB_H
+#define EGTB_H
+
+#include "types.h"
+#include <string>
+
+class Position;
+
+// Zorn's own distance-to-mate tables for the 3- and 4-man endings, built by
+// retrograde analysis. Each table is a <material>.zdtm file, e.g. KRPvK.zdtm,
+// holding one byte per position after board symmetry is taken out; tables
+// are memory mapped and found by material key. Castling and en passant
+// rights are not encoded and the 50-move rule is ignored.
+namespace EGTB
+{
+    constexpr int MaxPieces = 4;
+
+    // Maps the tables found in dir, replacing any loaded before
+    void init(const std::string& dir);
+
+    // egtbgen: generates every table missing from dir with the given number
+    // of threads, smaller endings first since captures and promotions lead
+    // into them, then loads the directory.
+    void generate(const std::string& dir, int threads);
+
+    // Mate score seen from ply, or the draw score, for a position in a
+    // loaded table. Returns false if it is not covered.
+    bool probe(const Position& pos, int ply, Value& v);
+
+    // The same as an evaluation: won positions score VALUE_KNOWN_WIN less
+    // the plies to mate, lost ones the negation.
+    bool probe_eval(const Position& pos, Value& v);
+}
+
+#endif
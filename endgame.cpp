@@ -0,0 +1,196 @@
+#include "endgame.h"
+#include "board.h"
+#include "bitboard.h"
+#include "eval.h"
+#include "move.h"
+
+namespace Endgames
+{
+    namespace
+    {
+        std::map<Key, Endgame> endgames;
+
+        // Registers the configuration for both colours. The code lists the
+        // strong side first, e.g. "KBNvK".
+        void add(const std::string& code, EvalFn fn)
+        {
+            for (Color c = WHITE; c <= BLACK; ++c)
+            {
+                StateInfo st;
+                Position pos;
+                endgames[pos.set(code, c, &st).material_key()] = Endgame{ fn, c };
+            }
+        }
+
+        // Bonus for driving the defending king to the edge of the board
+        int push_to_edge(Square s)
+        {
+            int rd = std::min(int(rank_of(s)), RANK_8 - rank_of(s));
+            int fd = std::min(int(file_of(s)), FILE_H - file_of(s));
+            return 90 - 10 * (rd + fd) - 10 * std::min(rd, fd);
+        }
+
+        // Bonus for keeping the two kings close together
+        int push_close(Square s1, Square s2)
+        {
+            return 140 - 20 * distance(s1, s2);
+        }
+
+        int material(const Position& pos, Color c)
+        {
+            return pos.count<PAWN>(c) * Eval::PieceValuesEG[PAWN]
+                + pos.count<KNIGHT>(c) * Eval::PieceValuesEG[KNIGHT]
+                + pos.count<BISHOP>(c) * Eval::PieceValuesEG[BISHOP]
+                + pos.count<ROOK>(c) * Eval::PieceValuesEG[ROOK]
+                + pos.count<QUEEN>(c) * Eval::PieceValuesEG[QUEEN];
+        }
+
+        Value known_win(int v)
+        {
+            return Value(std::min(v + VALUE_KNOWN_WIN, VALUE_MATE_IN_MAX_PLY - 1));
+        }
+
+        Value pov(const Position& pos, Color strongSide, Value v)
+        {
+            return strongSide == pos.side_to_move() ? v : Value(-v);
+        }
+    }
+
+    // Mating material against a lone king: drive the king to the edge and
+    // bring our own king closer.
+    Value KXK(const Position& pos, Color strongSide)
+    {
+        const Color weakSide = ~strongSide;
+
+        if (pos.side_to_move() == weakSide)
+        {
+            bool hasMove = false;
+            for (const auto& m : MoveList(pos))
+                if (pos.legal(m))
+                {
+                    hasMove = true;
+                    break;
+                }
+
+            if (!hasMove)
+                return VALUE_DRAW;
+        }
+
+        Square winnerKSq = pos.square<KING>(strongSide);
+        Square loserKSq = pos.square<KING>(weakSide);
+
+        int result = material(pos, strongSide)
+            + push_to_edge(loserKSq)
+            + push_close(winnerKSq, loserKSq);
+
+        Bitboard bishops = pos.pieces(strongSide, BISHOP);
+
+        if (pos.pieces(strongSide, QUEEN, ROOK)
+            || (pos.count<BISHOP>(strongSide) && pos.count<KNIGHT>(strongSide))
+            || ((bishops & DarkSquares) && (bishops & ~DarkSquares)))
+            return pov(pos, strongSide, known_win(result));
+
+        return pov(pos, strongSide, Value(std::min(result, int(VALUE_KNOWN_WIN) - 1)));
+    }
+
+    // Bishop and knight: mate is only possible in a corner of the bishop's colour.
+    Value KBNK(const Position& pos, Color strongSide)
+    {
+        const Color weakSide = ~strongSide;
+
+        Square winnerKSq = pos.square<KING>(strongSide);
+        Square loserKSq = pos.square<KING>(weakSide);
+        Square bishopSq = pos.square<BISHOP>(strongSide);
+
+        // Distance to the nearer of the two corners the bishop controls
+        int cornerDist = opposite_colors(bishopSq, SQ_A1)
+            ? std::min(distance(loserKSq, SQ_A8), distance(loserKSq, SQ_H1))
+            : std::min(distance(loserKSq, SQ_A1), distance(loserKSq, SQ_H8));
+
+        int result = Eval::PieceValuesEG[KNIGHT] + Eval::PieceValuesEG[BISHOP]
+            + push_close(winnerKSq, loserKSq)
+            + 60 * (7 - cornerDist);
+
+        return pov(pos, strongSide, known_win(result));
+    }
+
+    // King and pawn against king, exact via the KPK bitbase.
+    Value KPK(const Position& pos, Color strongSide)
+    {
+        // Normalise to White holding the pawn on files A-D
+        Square wksq = relative_square(strongSide, pos.square<KING>(strongSide));
+        Square bksq = relative_square(strongSide, pos.square<KING>(~strongSide));
+        Square psq = relative_square(strongSide, pos.square<PAWN>(strongSide));
+
+        if (file_of(psq) >= FILE_E)
+        {
+            wksq = Square(wksq ^ 7);
+            bksq = Square(bksq ^ 7);
+            psq = Square(psq ^ 7);
+        }
+
+        Color us = strongSide == pos.side_to_move() ? WHITE : BLACK;
+
+        if (!Bitbases::probe(wksq, psq, bksq, us))
+            return VALUE_DRAW;
+
+        return pov(pos, strongSide, known_win(Eval::PieceValuesEG[PAWN] + 20 * rank_of(psq)));
+    }
+
+    // Rook against pawn. Wins unless the defending king supports a far
+    // advanced pawn while the attacking king is cut off.
+    Value KRKP(const Position& pos, Color strongSide)
+    {
+        const Color weakSide = ~strongSide;
+
+        Square wksq = relative_square(strongSide, pos.square<KING>(strongSide));
+        Square bksq = relative_square(strongSide, pos.square<KING>(weakSide));
+        Square rsq = relative_square(strongSide, pos.square<ROOK>(strongSide));
+        Square psq = relative_square(strongSide, pos.square<PAWN>(weakSide));
+
+        Square queeningSq = make_square(file_of(psq), RANK_1);
+        Square belowPawn = Square(psq - 8);
+        int result;
+
+        // Our king stands in front of the pawn
+        if (forward_file_bb(WHITE, wksq) & square_bb(psq))
+            result = Eval::PieceValuesEG[ROOK] - distance(wksq, psq);
+
+        // The defending king is too far from both pawn and rook
+        else if (distance(bksq, psq) >= 3 + (pos.side_to_move() == weakSide)
+            && distance(bksq, rsq) >= 3)
+            result = Eval::PieceValuesEG[ROOK] - distance(wksq, psq);
+
+        // Advanced pawn supported by its king, our king far away
+        else if (rank_of(bksq) <= RANK_3
+            && distance(bksq, psq) == 1
+            && rank_of(wksq) >= RANK_4
+            && distance(wksq, psq) > 2 + (pos.side_to_move() == strongSide))
+            result = 80 - 8 * distance(wksq, psq);
+
+        else
+            result = 200 - 8 * (distance(wksq, belowPawn) - distance(bksq, belowPawn) - distance(psq, queeningSq));
+
+        return pov(pos, strongSide, Value(result));
+    }
+
+    // Two knights cannot force mate.
+    Value KNNK(const Position&, Color)
+    {
+        return VALUE_DRAW;
+    }
+
+    void init()
+    {
+        add("KBNvK", KBNK);
+        add("KPvK", KPK);
+        add("KRvKP", KRKP);
+        add("KNNvK", KNNK);
+    }
+
+    const Endgame* probe(Key materialKey)
+    {
+        auto it = endgames.find(materialKey);
+        return it == endgames.end() ? nullptr : &it->second;
+    }
+}
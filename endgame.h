@@ -0,0 +1,32 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "types.h"
+#include <map>
+#include <string>
+
+class Position;
+
+namespace Endgames
+{
+    // Exact or near-exact evaluation of a known material configuration,
+    // from the side to move's point of view.
+    typedef Value (*EvalFn)(const Position& pos, Color strongSide);
+
+    struct Endgame
+    {
+        EvalFn fn;
+        Color strongSide;
+    };
+
+    Value KXK(const Position& pos, Color strongSide);
+    Value KBNK(const Position& pos, Color strongSide);
+    Value KPK(const Position& pos, Color strongSide);
+    Value KRKP(const Position& pos, Color strongSide);
+    Value KNNK(const Position& pos, Color strongSide);
+
+    void init();
+    const Endgame* probe(Key materialKey);
+}
+
+#endif
@@ -1,6 +1,17 @@
 #include "eval.h"
 #include "eval_features.h"
 #include "board.h"
+#include "pawns.h"
+#include "material.h"
+#include "nnue.h"
+#include "search.h"
+#include "egtb.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
 
 namespace Eval
 {
@@ -9,73 +20,354 @@ namespace Eval
         0, 100, 320, 330, 500, 900, 0
     };
 
-    const Value PieceValuesMG[PIECE_TYPE_NB] =
+    const Score Tempo = make_score(10, 10);
+
+    // Margin for what king shield, mobility and threats can add to the
+    // material, piece-square and pawn score once blended. Searches of sharp
+    // middlegames never saw them move it by more than about 320.
+    const Value LazyMargin = 400;
+
+    Score psq[PIECE_NB][SQUARE_NB];
+
+    bool useNNUE = false;
+
+    void init()
     {
-        0, 124, 781, 825, 1276, 2538, 0
-    };
+        for (PieceType pt = PAWN; pt <= KING; ++pt)
+            for (Square s = SQ_A1; s <= SQ_H8; s = Square(s + 1))
+            {
+                Piece pc = make_piece(WHITE, pt);
+                Score score = make_score(PieceValuesMG[pt] + evaluatePieceSquare(pc, s, false) + squareBonus(pt, s),
+                    PieceValuesEG[pt] + evaluatePieceSquare(pc, s, true));
+
+                psq[pc][s] = score;
+                psq[make_piece(BLACK, pt)][Square(s ^ 56)] = -score;
+            }
+    }
 
-    const Value PieceValuesEG[PIECE_TYPE_NB] =
+    // Rounded down to a power of two entries; 0 disables the cache.
+    void Cache::resize(size_t mbSize)
     {
-        0, 206, 854, 915, 1380, 2682, 0
-    };
+        size_t entries = mbSize * 1024 * 1024 / sizeof(uint64_t);
+        size_t size = 1;
 
-    const int PiecePhase[PIECE_TYPE_NB] = { 0, 0, 1, 1, 2, 4, 0 };
+        while (size * 2 <= entries)
+            size *= 2;
 
-    void init()
+        table.assign(entries ? size : 0, 0);
+        mask = entries ? size - 1 : 0;
+    }
+
+    void Cache::clear()
+    {
+        std::fill(table.begin(), table.end(), 0);
+    }
+
+    Value blend(const Material::Entry* me, Score score, Color stm, bool oppositeBishops)
+    {
+        int mgScore = mg_value(score);
+        int egScore = eg_value(score);
+
+        Color strongSide = egScore > 0 ? WHITE : BLACK;
+        egScore = egScore * me->scale_factor(strongSide, oppositeBishops) / SCALE_FACTOR_NORMAL;
+
+        int maxPhase = 24;
+        int finalPhase = me->game_phase();
+
+        Value v = Value((mgScore * finalPhase + egScore * (maxPhase - finalPhase)) / maxPhase);
+
+        return stm == WHITE ? v : -v;
+    }
+
+    static Value blend(const Position& pos, const Material::Entry* me, Score score)
+    {
+        return blend(me, score, pos.side_to_move(), pos.opposite_bishops());
+    }
+
+    // Piece values alone, for configurations without piece-square tables.
+    static Score material(const Position& pos)
+    {
+        Score score = SCORE_ZERO;
+
+        for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+            score += (popcount(pos.pieces(WHITE, pt)) - popcount(pos.pieces(BLACK, pt)))
+                * make_score(PieceValuesMG[pt], PieceValuesEG[pt]);
+
+        return score;
+    }
+
+    // The tests on Policy members are compile-time constants; each
+    // instantiation keeps only the code for its own terms.
+    template<typename Policy>
+    static Value do_evaluate(const Position& pos, Value alpha, Value beta, bool& lazy)
     {
+        const bool Positional = Policy::UseKingShield || Policy::UseMobility || Policy::UseThreats;
+
+        lazy = false;
+
+        Material::Entry* me = Material::probe(pos);
+
+        if (me->specialized_eval_exists())
+            return me->evaluate(pos);
+
+        if (useNNUE)
+            return NNUE::evaluate(pos);
+
+        Score score = (Policy::UsePieceSquare ? pos.psq_score() : material(pos))
+            + (pos.side_to_move() == WHITE ? Tempo : -Tempo);
+
+        if (Policy::UseImbalance)
+            score += me->imbalance();
+
+        // Pawn attacks and the king shield cache live in the pawn entry too
+        Pawns::Entry* pe = Policy::UsePawnStructure || Positional ? Pawns::probe(pos) : nullptr;
+
+        if (Policy::UsePawnStructure)
+            score += pe->score();
+
+        Value v = blend(pos, me, score);
+
+        if (!Positional)
+            return v;
+
+        if (v + LazyMargin <= alpha || v - LazyMargin >= beta)
+        {
+            lazy = true;
+            return v;
+        }
+
+        Value positional = 0;
+
+        if (Policy::UseKingShield)
+            positional += pe->king_shield<WHITE>(pos, pos.square<KING>(WHITE))
+                - pe->king_shield<BLACK>(pos, pos.square<KING>(BLACK));
+
+        if (Policy::UseMobility || Policy::UseThreats)
+        {
+            EvalInfo ei;
+            initEvalInfo(pos, pe, ei);
+
+            if (Policy::UseMobility)
+                positional += ei.mobility[WHITE] - ei.mobility[BLACK];
+
+            if (Policy::UseThreats)
+                positional += evaluateThreats(pos, ei);
+        }
+
+        return blend(pos, me, score + make_score(positional, positional));
+    }
+
+    namespace
+    {
+        typedef Value (*EvaluateFn)(const Position& pos, Value alpha, Value beta, bool& lazy);
+
+        struct Config
+        {
+            const char* name;
+            EvaluateFn fn;
+        };
+
+        const Config Configs[] =
+        {
+            { EvalFull::name(), do_evaluate<EvalFull> },
+            { EvalFast::name(), do_evaluate<EvalFast> },
+            { EvalMaterial::name(), do_evaluate<EvalMaterial> }
+        };
+
+        EvaluateFn doEvaluate = do_evaluate<DefaultEvalPolicy>;
+    }
+
+    std::vector<std::string> config_names()
+    {
+        std::vector<std::string> names;
+
+        for (const Config& c : Configs)
+            names.push_back(c.name);
+
+        return names;
+    }
+
+    bool set_config(const std::string& name)
+    {
+        for (const Config& c : Configs)
+            if (name == c.name)
+            {
+                doEvaluate = c.fn;
+                return true;
+            }
+
+        return false;
+    }
+
+    Value evaluate(const Position& pos, Value alpha, Value beta, bool& lazy)
+    {
+        Thread* th = pos.this_thread();
+        Value v;
+
+        lazy = false;
+        if (th->evalCache.probe(pos.key(), v) || EGTB::probe_eval(pos, v))
+            return v;
+
+        v = doEvaluate(pos, alpha, beta, lazy);
+
+        ++th->lazyStats.evaluations;
+
+        if (lazy)
+            ++th->lazyStats.exits[v > alpha];
+        else
+            th->evalCache.store(pos.key(), v);
+
+        return v;
+    }
+
+    Value evaluate_full(const Position& pos)
+    {
+        bool lazy;
+        return do_evaluate<EvalFull>(pos, -VALUE_INFINITE, VALUE_INFINITE, lazy);
     }
 
     Value evaluate(const Position& pos)
     {
-        Value mgScore = 0, egScore = 0;
-        int gamePhase = 0;
+        bool lazy;
+        return evaluate(pos, -VALUE_INFINITE, VALUE_INFINITE, lazy);
+    }
+
+    // Cost and effect of each classical term over the positions of an EPD
+    // file. Each term is timed on its own, iterations times per position;
+    // pawn and material terms are hash probes and are timed with warm
+    // tables, as search mostly sees them. The contribution of a term is the
+    // blended score with it minus the score without it, from White's point
+    // of view, and a sign change means leaving it out flips who is ahead.
+    void profile(const std::string& fileName, int iterations)
+    {
+        std::ifstream file(fileName);
+        if (!file)
+        {
+            std::cout << "info string Cannot open " << fileName << std::endl;
+            return;
+        }
+
+        enum { PSQ, IMBALANCE, PAWNS, KING_SHIELD, MOBILITY, THREATS, TERM_NB };
+        const char* names[TERM_NB] = { "psq", "imbalance", "pawns", "kingshield", "mobility", "threats" };
+
+        typedef std::chrono::steady_clock Clock;
+        uint64_t ns[TERM_NB] = {}, signChanges[TERM_NB] = {};
+        int64_t sum[TERM_NB] = {}, absSum[TERM_NB] = {};
+        uint64_t positions = 0, skipped = 0;
+        int sink = 0;
+
+        iterations = std::max(iterations, 1);
 
-        for (Square s = SQ_A1; s <= SQ_H8; s = Square(s + 1))
+        std::string line;
+        while (std::getline(file, line))
         {
-            Piece pc = pos.piece_on(s);
-            if (pc != NO_PIECE)
+            std::istringstream ss(line);
+            std::string fields[4];
+            if (!(ss >> fields[0] >> fields[1] >> fields[2] >> fields[3]))
+                continue;
+
+            Position pos;
+            StateInfo st;
+            pos.set(fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + " 0 1", false, &st, Threads);
+
+            Material::Entry* me = Material::probe(pos);
+            if (me->specialized_eval_exists())
             {
-                PieceType pt = type_of(pc);
-                Color c = color_of(pc);
+                ++skipped;
+                continue;
+            }
 
-                Value mgPieceValue = PieceValuesMG[pt];
-                Value egPieceValue = PieceValuesEG[pt];
-                Value mgPST = evaluatePieceSquare(pc, s, false);
-                Value egPST = evaluatePieceSquare(pc, s, true);
+            Pawns::Entry* pe = Pawns::probe(pos);
+            Square wksq = pos.square<KING>(WHITE), bksq = pos.square<KING>(BLACK);
+            EvalInfo ei;
+            Score term[TERM_NB];
 
-                if (c == WHITE)
-                {
-                    mgScore += mgPieceValue + mgPST;
-                    egScore += egPieceValue + egPST;
-                }
-                else
+            Clock::time_point t[TERM_NB + 1];
+            t[0] = Clock::now();
+
+            for (int i = 0; i < iterations; ++i)
+            {
+                Score psq = SCORE_ZERO;
+                for (Bitboard b = pos.pieces(); b; )
                 {
-                    mgScore -= mgPieceValue + mgPST;
-                    egScore -= egPieceValue + egPST;
+                    Square s = pop_lsb(b);
+                    psq += Eval::psq[pos.piece_on(s)][s];
                 }
+                term[PSQ] = psq;
+            }
+            t[1] = Clock::now();
 
-                gamePhase += PiecePhase[pt];
+            for (int i = 0; i < iterations; ++i)
+                term[IMBALANCE] = Material::probe(pos)->imbalance();
+            t[2] = Clock::now();
+
+            for (int i = 0; i < iterations; ++i)
+                term[PAWNS] = Pawns::probe(pos)->score();
+            t[3] = Clock::now();
+
+            for (int i = 0; i < iterations; ++i)
+            {
+                Value v = pe->king_shield<WHITE>(pos, wksq) - pe->king_shield<BLACK>(pos, bksq);
+                term[KING_SHIELD] = make_score(v, v);
             }
-        }
+            t[4] = Clock::now();
+
+            for (int i = 0; i < iterations; ++i)
+            {
+                initEvalInfo(pos, pe, ei);
+                Value v = ei.mobility[WHITE] - ei.mobility[BLACK];
+                term[MOBILITY] = make_score(v, v);
+            }
+            t[5] = Clock::now();
 
-        mgScore += evaluateCenter(pos);
-        mgScore += evaluateKnightPenalties(pos);
-        mgScore += evaluateKingSafety(pos);
-        mgScore += evaluateMobility(pos);
-        mgScore += evaluateThreats(pos);
+            for (int i = 0; i < iterations; ++i)
+            {
+                Value v = evaluateThreats(pos, ei);
+                term[THREATS] = make_score(v, v);
+            }
+            t[6] = Clock::now();
 
-        egScore += evaluateKingSafety(pos);
-        egScore += evaluateMobility(pos);
-        egScore += evaluateThreats(pos);
+            Score total = pos.side_to_move() == WHITE ? Tempo : -Tempo;
+            for (int i = 0; i < TERM_NB; ++i)
+            {
+                ns[i] += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t[i + 1] - t[i]).count());
+                total += term[i];
+            }
 
-        mgScore += (pos.side_to_move() == WHITE) ? 10 : -10;
-        egScore += (pos.side_to_move() == WHITE) ? 10 : -10;
+            int sign = pos.side_to_move() == WHITE ? 1 : -1;
+            int full = sign * blend(pos, me, total);
+            sink += full;
 
-        int maxPhase = 24;
-        int finalPhase = gamePhase > maxPhase ? maxPhase : gamePhase;
+            for (int i = 0; i < TERM_NB; ++i)
+            {
+                int without = sign * blend(pos, me, total - term[i]);
+                sum[i] += full - without;
+                absSum[i] += std::abs(full - without);
+                signChanges[i] += (full > 0) != (without > 0);
+            }
 
-        Value score = (mgScore * finalPhase + egScore * (maxPhase - finalPhase)) / maxPhase;
+            ++positions;
+        }
 
-        return score;
+        if (!positions)
+        {
+            std::cout << "info string No positions evaluated (" << skipped << " known endgames skipped)" << std::endl;
+            return;
+        }
+
+        uint64_t calls = positions * uint64_t(iterations);
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "evalprofile positions " << positions << " skipped " << skipped
+            << " iterations " << iterations << " (checksum " << sink << ")" << std::endl;
+
+        for (int i = 0; i < TERM_NB; ++i)
+            std::cout << std::left << std::setw(12) << names[i] << std::right
+                << " ns/call " << std::setw(8) << double(ns[i]) / calls
+                << " avg " << std::setw(8) << double(sum[i]) / positions
+                << " avg|x| " << std::setw(8) << double(absSum[i]) / positions
+                << " signchanges " << std::setw(5) << 100.0 * signChanges[i] / positions << "%" << std::endl;
+
+        std::cout.unsetf(std::ios::floatfield);
     }
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 #define EVAL_H
 
 #include "types.h"
+#include <string>
+#include <vector>
 
 class Position;
 
@@ -11,8 +13,100 @@ namespace Eval
     extern const Value PieceValuesMG[PIECE_TYPE_NB];
     extern const Value PieceValuesEG[PIECE_TYPE_NB];
 
+    // Direct-mapped cache of evaluate() results, one per thread. A slot packs
+    // the upper 48 key bits with the 16-bit score so it is a single word.
+    class Cache
+    {
+    public:
+        void resize(size_t mbSize);
+        void clear();
+
+        bool probe(Key key, Value& v) const
+        {
+            if (table.empty())
+                return false;
+
+            uint64_t e = table[key & mask];
+            if ((e ^ key) >> 16)
+                return false;
+
+            v = Value(int16_t(uint16_t(e)));
+            return true;
+        }
+
+        void store(Key key, Value v)
+        {
+            if (!table.empty())
+                table[key & mask] = (key & ~0xFFFFULL) | uint16_t(v);
+        }
+
+    private:
+        std::vector<uint64_t> table;
+        size_t mask = 0;
+    };
+
+    // Material, piece-square and square bonuses for each piece and square,
+    // from White's point of view. Position keeps their sum incrementally.
+    extern Score psq[PIECE_NB][SQUARE_NB];
+
+    extern bool useNNUE;
+
+    // Compile-time choice of classical terms. Each configuration gets its own
+    // instantiation of the evaluation, so a disabled term costs nothing: no
+    // code, no branch. Without PieceSquare only piece values are counted.
+    template<bool PieceSquare, bool Imbalance, bool PawnStructure, bool KingShield, bool Mobility, bool Threats>
+    struct EvalTerms
+    {
+        static constexpr bool UsePieceSquare = PieceSquare;
+        static constexpr bool UseImbalance = Imbalance;
+        static constexpr bool UsePawnStructure = PawnStructure;
+        static constexpr bool UseKingShield = KingShield;
+        static constexpr bool UseMobility = Mobility;
+        static constexpr bool UseThreats = Threats;
+    };
+
+    struct EvalFull : EvalTerms<true, true, true, true, true, true> { static const char* name() { return "Full"; } };
+    struct EvalFast : EvalTerms<true, true, true, true, false, false> { static const char* name() { return "Fast"; } };
+    struct EvalMaterial : EvalTerms<false, false, false, false, false, false> { static const char* name() { return "Material"; } };
+
+#ifndef ZORN_EVAL_POLICY
+#define ZORN_EVAL_POLICY EvalFull
+#endif
+
+    typedef ZORN_EVAL_POLICY DefaultEvalPolicy;
+
+    // Names of the configurations above, and selection of the one evaluate()
+    // uses; false for an unknown name. Batch evaluation, evalprofile and the
+    // tuner always use the full evaluation.
+    std::vector<std::string> config_names();
+    bool set_config(const std::string& name);
+
+    // How often the windowed evaluate() skipped the positional terms, split
+    // into fail-low and fail-high exits. Evaluations served from the cache
+    // are not counted.
+    struct LazyStats
+    {
+        uint64_t evaluations = 0;
+        uint64_t exits[2] = {};
+    };
+
+    // Score from the side to move's point of view, as negamax expects.
     Value evaluate(const Position& pos);
+
+    // Returns the material, piece-square and pawn score alone when it is so
+    // far outside [alpha, beta] that the remaining terms cannot bring it
+    // back, and sets lazy. Such results are only good for that window and
+    // must not be cached or stored anywhere as a static eval.
+    Value evaluate(const Position& pos, Value alpha, Value beta, bool& lazy);
+
+    // The Full configuration, without the evaluation cache or the EGTB: what
+    // batch evaluation computes, whatever EvalConfig and EGTBPath are set to
+    Value evaluate_full(const Position& pos);
     void init();
+
+    // evalprofile: per-term time, average contribution and sign changes over
+    // the positions of an EPD file.
+    void profile(const std::string& fileName, int iterations);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,629 @@
+#include "eval_batch.h"
+#include "eval.h"
+#include "eval_features.h"
+#include "board.h"
+#include "pawns.h"
+#include "material.h"
+#include "search.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if defined(ZORN_NO_SIMD)
+#elif defined(__AVX2__)
+#define BATCH_AVX2
+#include <immintrin.h>
+#endif
+
+namespace Eval
+{
+    void Batch::clear()
+    {
+        for (Color c = WHITE; c <= BLACK; ++c)
+            for (int pt = NO_PIECE_TYPE; pt < PIECE_TYPE_NB; ++pt)
+                bb[c][pt].clear();
+
+        sideToMove.clear();
+    }
+
+    void Batch::reserve(size_t n)
+    {
+        for (Color c = WHITE; c <= BLACK; ++c)
+            for (int pt = NO_PIECE_TYPE; pt < PIECE_TYPE_NB; ++pt)
+                bb[c][pt].reserve(n);
+
+        sideToMove.reserve(n);
+    }
+
+    namespace
+    {
+        const char PieceChars[] = " PNBRQK  pnbrqk";
+
+        // FEN board characters: a piece, a run of empty squares as its
+        // negated length, or 0 for anything else.
+        struct FenChars
+        {
+            int8_t code[256];
+
+            FenChars()
+            {
+                for (int c = 0; c < 256; ++c)
+                    code[c] = c >= '1' && c <= '8' ? -(c - '0') : 0;
+
+                for (Piece pc = W_PAWN; pc <= B_KING; ++pc)
+                    if (PieceChars[pc] != ' ')
+                        code[uint8_t(PieceChars[pc])] = int8_t(pc);
+            }
+        };
+    }
+
+    bool Batch::add(const std::string& fen)
+    {
+        static const FenChars fenChars;
+
+        Bitboard byPiece[PIECE_NB] = {};
+        const char* p = fen.c_str();
+        int rank = 7, file = 0;
+
+        for (; *p && *p != ' '; ++p)
+        {
+            if (*p == '/')
+            {
+                if (file != 8 || rank == 0)
+                    return false;
+                --rank, file = 0;
+            }
+            else
+            {
+                int code = fenChars.code[uint8_t(*p)];
+
+                if (code < 0)
+                    file -= code;
+                else if (!code || file > 7)
+                    return false;
+                else
+                    byPiece[code] |= 1ULL << (rank * 8 + file++);
+            }
+
+            if (file > 8)
+                return false;
+        }
+
+        if (rank != 0 || file != 8 || *p != ' ' || (p[1] != 'w' && p[1] != 'b')
+            || popcount(byPiece[W_KING]) != 1 || popcount(byPiece[B_KING]) != 1)
+            return false;
+
+        for (Color c = WHITE; c <= BLACK; ++c)
+        {
+            Bitboard all = 0;
+
+            for (PieceType pt = PAWN; pt <= KING; ++pt)
+            {
+                bb[c][pt].push_back(byPiece[make_piece(c, pt)]);
+                all |= byPiece[make_piece(c, pt)];
+            }
+
+            bb[c][NO_PIECE_TYPE].push_back(all);
+        }
+
+        sideToMove.push_back(p[1] == 'w' ? WHITE : BLACK);
+        return true;
+    }
+
+    void Batch::add(const Position& pos)
+    {
+        for (Color c = WHITE; c <= BLACK; ++c)
+        {
+            bb[c][NO_PIECE_TYPE].push_back(pos.pieces(c));
+            for (PieceType pt = PAWN; pt <= KING; ++pt)
+                bb[c][pt].push_back(pos.pieces(c, pt));
+        }
+
+        sideToMove.push_back(pos.side_to_move());
+    }
+
+    const char* batch_simd_name()
+    {
+#if defined(BATCH_AVX2)
+        return "avx2";
+#else
+        return "scalar";
+#endif
+    }
+
+    namespace
+    {
+        // The terms computed on whole piece sets: White mobility and threats
+        // minus Black's, and the pawn structure.
+        struct SetTerms
+        {
+            Value mobility;
+            Value threats;
+            Pawns::Structure pawns;
+        };
+
+        // Same attack maps and sums as initEvalInfo and evaluateThreats, read
+        // from the batch instead of a Position.
+        SetTerms set_terms(const Batch& batch, size_t i)
+        {
+            Bitboard occupied = batch.bb[WHITE][NO_PIECE_TYPE][i] | batch.bb[BLACK][NO_PIECE_TYPE][i];
+            Bitboard attacked[COLOR_NB];
+            Value mobility[COLOR_NB];
+
+            for (Color c = WHITE; c <= BLACK; ++c)
+            {
+                Bitboard own = batch.bb[c][NO_PIECE_TYPE][i];
+                Bitboard pawns = batch.bb[c][PAWN][i];
+
+                attacked[c] = (c == WHITE ? pawn_attacks_bb<WHITE>(pawns) : pawn_attacks_bb<BLACK>(pawns))
+                    | king_attacks_bb(lsb(batch.bb[c][KING][i]));
+                mobility[c] = 0;
+
+                for (PieceType pt = KNIGHT; pt <= QUEEN; ++pt)
+                    for (Bitboard b = batch.bb[c][pt][i]; b; )
+                    {
+                        Bitboard attacks = attacks_bb(pt, pop_lsb(b), occupied);
+
+                        attacked[c] |= attacks;
+                        mobility[c] += popcount(attacks & ~own) * MobilityWeight[pt];
+                    }
+            }
+
+            Value threats = 0;
+
+            for (Color c = WHITE; c <= BLACK; ++c)
+            {
+                Bitboard hanging = batch.bb[c][NO_PIECE_TYPE][i] & attacked[~c] & ~attacked[c];
+
+                for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+                    threats += (c == WHITE ? -1 : 1) * HangingPenalty[pt] * popcount(hanging & batch.bb[c][pt][i]);
+            }
+
+            return { Value(mobility[WHITE] - mobility[BLACK]), threats,
+                Pawns::structure(batch.bb[WHITE][PAWN][i], batch.bb[BLACK][PAWN][i]) };
+        }
+
+#if defined(BATCH_AVX2)
+        // Four positions at once, one per 64-bit lane. Attacks of a whole set
+        // of pieces are built by shifting the set: leapers one shift per
+        // direction, sliders with a Kogge-Stone fill through empty squares.
+        // No square is reached by two pieces of the same set along the same
+        // direction, so summing the popcounts per direction gives the same
+        // mobility as summing them per piece.
+        typedef __m256i Vec;
+
+        const Bitboard NotA = ~0x0101010101010101ULL, NotH = ~0x8080808080808080ULL;
+        const Bitboard NotAB = ~0x0303030303030303ULL, NotGH = ~0xC0C0C0C0C0C0C0C0ULL;
+
+        inline Vec load(const std::vector<Bitboard>& v, size_t i) { return _mm256_loadu_si256((const __m256i*)&v[i]); }
+        inline Vec bcast(Bitboard b) { return _mm256_set1_epi64x(int64_t(b)); }
+        inline Vec vand(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+        inline Vec vor(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+        inline Vec andnot(Vec a, Vec b) { return _mm256_andnot_si256(b, a); }
+
+        // Shift towards higher squares for positive D.
+        template<int D>
+        inline Vec shift(Vec b)
+        {
+            return D > 0 ? _mm256_slli_epi64(b, D > 0 ? D : 0) : _mm256_srli_epi64(b, D < 0 ? -D : 0);
+        }
+
+        template<int D>
+        inline Vec slide(Vec gen, Vec empty, Vec mask)
+        {
+            Vec pro = vand(empty, mask);
+            gen = vor(gen, vand(pro, shift<D>(gen)));
+            pro = vand(pro, shift<D>(pro));
+            gen = vor(gen, vand(pro, shift<2 * D>(gen)));
+            pro = vand(pro, shift<2 * D>(pro));
+            gen = vor(gen, vand(pro, shift<4 * D>(gen)));
+            return vand(shift<D>(gen), mask);
+        }
+
+        // Per-byte popcounts (Mula's nibble lookup); sums of up to 31 of them
+        // still fit a byte and are reduced per lane with sad() at the end.
+        inline Vec popcount8(Vec v)
+        {
+            const Vec lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const Vec low = _mm256_set1_epi8(0x0F);
+
+            return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, vand(v, low)),
+                _mm256_shuffle_epi8(lookup, vand(_mm256_srli_epi16(v, 4), low)));
+        }
+
+        inline Vec sad(Vec bytes) { return _mm256_sad_epu8(bytes, _mm256_setzero_si256()); }
+
+        inline Vec weighted(Vec count, Value weight) { return _mm256_mul_epi32(count, _mm256_set1_epi64x(weight)); }
+
+        struct Acc
+        {
+            Vec attacks, count;
+
+            void add(Vec a, Vec notOwn)
+            {
+                attacks = vor(attacks, a);
+                count = _mm256_add_epi8(count, popcount8(vand(a, notOwn)));
+            }
+        };
+
+        template<Color Us>
+        void set_terms4(const Batch& batch, size_t i, Vec empty, Vec& attacked, Vec& mobility)
+        {
+            const Vec notOwn = andnot(_mm256_set1_epi64x(-1), load(batch.bb[Us][NO_PIECE_TYPE], i));
+            const Vec mA = bcast(NotA), mH = bcast(NotH), mAB = bcast(NotAB), mGH = bcast(NotGH);
+            const Vec all = _mm256_set1_epi64x(-1);
+            const Vec zero = _mm256_setzero_si256();
+
+            Vec pawns = load(batch.bb[Us][PAWN], i);
+            Vec king = load(batch.bb[Us][KING], i);
+
+            attacked = Us == WHITE ? vor(vand(shift<9>(pawns), mA), vand(shift<7>(pawns), mH))
+                : vor(vand(shift<-7>(pawns), mA), vand(shift<-9>(pawns), mH));
+
+            attacked = vor(attacked, vor(shift<8>(king), shift<-8>(king)));
+            attacked = vor(attacked, vand(mA, vor(shift<1>(king), vor(shift<9>(king), shift<-7>(king)))));
+            attacked = vor(attacked, vand(mH, vor(shift<-1>(king), vor(shift<-9>(king), shift<7>(king)))));
+
+            Vec knights = load(batch.bb[Us][KNIGHT], i);
+            Acc n = { zero, zero };
+            n.add(vand(shift<17>(knights), mA), notOwn);
+            n.add(vand(shift<15>(knights), mH), notOwn);
+            n.add(vand(shift<10>(knights), mAB), notOwn);
+            n.add(vand(shift<6>(knights), mGH), notOwn);
+            n.add(vand(shift<-6>(knights), mAB), notOwn);
+            n.add(vand(shift<-10>(knights), mGH), notOwn);
+            n.add(vand(shift<-15>(knights), mA), notOwn);
+            n.add(vand(shift<-17>(knights), mH), notOwn);
+
+            Vec bishops = load(batch.bb[Us][BISHOP], i);
+            Acc b = { zero, zero };
+            b.add(slide<9>(bishops, empty, mA), notOwn);
+            b.add(slide<7>(bishops, empty, mH), notOwn);
+            b.add(slide<-7>(bishops, empty, mA), notOwn);
+            b.add(slide<-9>(bishops, empty, mH), notOwn);
+
+            Vec rooks = load(batch.bb[Us][ROOK], i);
+            Acc r = { zero, zero };
+            r.add(slide<8>(rooks, empty, all), notOwn);
+            r.add(slide<-8>(rooks, empty, all), notOwn);
+            r.add(slide<1>(rooks, empty, mA), notOwn);
+            r.add(slide<-1>(rooks, empty, mH), notOwn);
+
+            Vec queens = load(batch.bb[Us][QUEEN], i);
+            Acc q = { zero, zero };
+            q.add(slide<9>(queens, empty, mA), notOwn);
+            q.add(slide<7>(queens, empty, mH), notOwn);
+            q.add(slide<-7>(queens, empty, mA), notOwn);
+            q.add(slide<-9>(queens, empty, mH), notOwn);
+            q.add(slide<8>(queens, empty, all), notOwn);
+            q.add(slide<-8>(queens, empty, all), notOwn);
+            q.add(slide<1>(queens, empty, mA), notOwn);
+            q.add(slide<-1>(queens, empty, mH), notOwn);
+
+            attacked = vor(vor(attacked, n.attacks), vor(vor(b.attacks, r.attacks), q.attacks));
+            mobility = _mm256_add_epi64(_mm256_add_epi64(weighted(sad(n.count), MobilityWeight[KNIGHT]),
+                weighted(sad(b.count), MobilityWeight[BISHOP])),
+                _mm256_add_epi64(weighted(sad(r.count), MobilityWeight[ROOK]),
+                    weighted(sad(q.count), MobilityWeight[QUEEN])));
+        }
+
+        template<Color Us>
+        Vec hanging_penalty4(const Batch& batch, size_t i, Vec ourAttacks, Vec theirAttacks)
+        {
+            Vec hanging = andnot(vand(load(batch.bb[Us][NO_PIECE_TYPE], i), theirAttacks), ourAttacks);
+            Vec penalty = _mm256_setzero_si256();
+
+            for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+                penalty = _mm256_add_epi64(penalty,
+                    weighted(sad(popcount8(vand(hanging, load(batch.bb[Us][pt], i)))), HangingPenalty[pt]));
+
+            return penalty;
+        }
+
+        inline Vec north_fill(Vec b)
+        {
+            b = vor(b, shift<8>(b));
+            b = vor(b, shift<16>(b));
+            return vor(b, shift<32>(b));
+        }
+
+        inline Vec south_fill(Vec b)
+        {
+            b = vor(b, shift<-8>(b));
+            b = vor(b, shift<-16>(b));
+            return vor(b, shift<-32>(b));
+        }
+
+        inline Vec sideways(Vec b) { return vor(vand(shift<1>(b), bcast(NotA)), vand(shift<-1>(b), bcast(NotH))); }
+
+        // Pawns::structure() for four positions.
+        template<Color Us>
+        void pawn_structure4(Vec ours, Vec theirs, Vec theirAttacks, Pawns::Structure* st)
+        {
+            Vec ahead = Us == WHITE ? south_fill(shift<-8>(ours)) : north_fill(shift<8>(ours));
+            Vec theirAhead = Us == WHITE ? south_fill(shift<-8>(theirs)) : north_fill(shift<8>(theirs));
+            Vec supported = sideways(Us == WHITE ? north_fill(ours) : south_fill(ours));
+            Vec stopAttacked = Us == WHITE ? shift<-8>(theirAttacks) : shift<8>(theirAttacks);
+
+            Vec isolated = andnot(ours, sideways(north_fill(south_fill(ours))));
+            Vec backward = andnot(andnot(vand(ours, stopAttacked), isolated), supported);
+            Vec doubled = vand(ours, ahead);
+            Vec passed = andnot(andnot(ours, doubled), vor(theirAhead, sideways(theirAhead)));
+
+            alignas(32) Bitboard b[4][4];
+            _mm256_store_si256((__m256i*)b[0], isolated);
+            _mm256_store_si256((__m256i*)b[1], backward);
+            _mm256_store_si256((__m256i*)b[2], doubled);
+            _mm256_store_si256((__m256i*)b[3], passed);
+
+            for (int k = 0; k < 4; ++k)
+            {
+                st[k].isolated[Us] = b[0][k];
+                st[k].backward[Us] = b[1][k];
+                st[k].doubled[Us] = b[2][k];
+                st[k].passed[Us] = b[3][k];
+            }
+        }
+
+        void set_terms4(const Batch& batch, size_t i, SetTerms* terms)
+        {
+            Vec empty = andnot(_mm256_set1_epi64x(-1),
+                vor(load(batch.bb[WHITE][NO_PIECE_TYPE], i), load(batch.bb[BLACK][NO_PIECE_TYPE], i)));
+
+            Vec attacked[COLOR_NB], mobility[COLOR_NB];
+            set_terms4<WHITE>(batch, i, empty, attacked[WHITE], mobility[WHITE]);
+            set_terms4<BLACK>(batch, i, empty, attacked[BLACK], mobility[BLACK]);
+
+            alignas(32) int64_t mob[4], thr[4];
+            _mm256_store_si256((__m256i*)mob, _mm256_sub_epi64(mobility[WHITE], mobility[BLACK]));
+            _mm256_store_si256((__m256i*)thr, _mm256_sub_epi64(
+                hanging_penalty4<BLACK>(batch, i, attacked[BLACK], attacked[WHITE]),
+                hanging_penalty4<WHITE>(batch, i, attacked[WHITE], attacked[BLACK])));
+
+            for (int k = 0; k < 4; ++k)
+            {
+                terms[k].mobility = Value(mob[k]);
+                terms[k].threats = Value(thr[k]);
+            }
+
+            Pawns::Structure st[4];
+            Vec whitePawns = load(batch.bb[WHITE][PAWN], i), blackPawns = load(batch.bb[BLACK][PAWN], i);
+            Vec mA = bcast(NotA), mH = bcast(NotH);
+
+            pawn_structure4<WHITE>(whitePawns, blackPawns,
+                vor(vand(shift<-7>(blackPawns), mA), vand(shift<-9>(blackPawns), mH)), st);
+            pawn_structure4<BLACK>(blackPawns, whitePawns,
+                vor(vand(shift<9>(whitePawns), mA), vand(shift<7>(whitePawns), mH)), st);
+
+            for (int k = 0; k < 4; ++k)
+                terms[k].pawns = st[k];
+        }
+#endif
+
+        // Board and side to move of position i, for the evaluations that need
+        // a real Position.
+        std::string fen(const Batch& batch, size_t i)
+        {
+            std::string s;
+
+            for (int rank = 7; rank >= 0; --rank)
+            {
+                int empty = 0;
+
+                for (int file = 0; file < 8; ++file)
+                {
+                    Bitboard sq = square_bb(Square(rank * 8 + file));
+                    Piece pc = NO_PIECE;
+
+                    for (Color c = WHITE; c <= BLACK; ++c)
+                        for (PieceType pt = PAWN; pt <= KING; ++pt)
+                            if (batch.bb[c][pt][i] & sq)
+                                pc = make_piece(c, pt);
+
+                    if (pc == NO_PIECE)
+                        ++empty;
+                    else
+                    {
+                        if (empty)
+                            s += char('0' + empty), empty = 0;
+                        s += PieceChars[pc];
+                    }
+                }
+
+                if (empty)
+                    s += char('0' + empty);
+                if (rank)
+                    s += '/';
+            }
+
+            return s + (batch.sideToMove[i] == WHITE ? " w - - 0 1" : " b - - 0 1");
+        }
+
+        // materialKeys[pc][n] is the material key contribution of n pieces pc,
+        // so a key costs one lookup per piece kind instead of one per piece.
+        struct MaterialKeys
+        {
+            Key keys[PIECE_NB][SQUARE_NB + 1];
+
+            MaterialKeys()
+            {
+                for (Piece pc = NO_PIECE; pc < PIECE_NB; ++pc)
+                {
+                    keys[pc][0] = 0;
+                    for (int n = 0; n < SQUARE_NB; ++n)
+                        keys[pc][n + 1] = keys[pc][n] ^ Zobrist::psq[pc][n];
+                }
+            }
+        };
+
+        // Everything evaluate() adds to the set terms: material entry from
+        // th's table, piece-square sum, king shield and the final blend.
+        // Specialised endgames and NNUE go through a Position.
+        Value finish(const Batch& batch, size_t i, const SetTerms& terms, Thread* th)
+        {
+            static const MaterialKeys materialKeys;
+
+            Material::Counts n;
+            Key materialKey = 0;
+
+            for (Color c = WHITE; c <= BLACK; ++c)
+            {
+                n[c][NO_PIECE_TYPE] = 0;
+
+                for (PieceType pt = PAWN; pt <= KING; ++pt)
+                {
+                    n[c][pt] = popcount(batch.bb[c][pt][i]);
+                    materialKey ^= materialKeys.keys[make_piece(c, pt)][n[c][pt]];
+                }
+            }
+
+            Material::Entry* me = Material::probe(th->materialTable, materialKey, n);
+
+            if (me->specialized_eval_exists() || useNNUE)
+            {
+                Position pos;
+                StateInfo st;
+                pos.set(fen(batch, i), false, &st, th);
+                return evaluate_full(pos);
+            }
+
+            Score score = SCORE_ZERO;
+
+            for (Color c = WHITE; c <= BLACK; ++c)
+                for (PieceType pt = PAWN; pt <= KING; ++pt)
+                {
+                    const Score* table = psq[make_piece(c, pt)];
+
+                    for (Bitboard b = batch.bb[c][pt][i]; b; )
+                        score += table[pop_lsb(b)];
+                }
+
+            Color stm = Color(batch.sideToMove[i]);
+            Value kingShield = Pawns::king_shield<WHITE>(batch.bb[WHITE][PAWN][i], lsb(batch.bb[WHITE][KING][i]))
+                - Pawns::king_shield<BLACK>(batch.bb[BLACK][PAWN][i], lsb(batch.bb[BLACK][KING][i]));
+
+            score += me->imbalance() + Pawns::score(terms.pawns) + (stm == WHITE ? Tempo : -Tempo)
+                + make_score(kingShield, kingShield)
+                + make_score(terms.mobility, terms.mobility)
+                + make_score(terms.threats, terms.threats);
+
+            bool oppositeBishops = n[WHITE][BISHOP] == 1 && n[BLACK][BISHOP] == 1
+                && opposite_colors(lsb(batch.bb[WHITE][BISHOP][i]), lsb(batch.bb[BLACK][BISHOP][i]));
+
+            return blend(me, score, stm, oppositeBishops);
+        }
+    }
+
+    void evaluate(const Batch& batch, Value* out, Thread* th)
+    {
+        size_t i = 0;
+
+#if defined(BATCH_AVX2)
+        for (SetTerms terms[4]; i + 4 <= batch.size(); i += 4)
+        {
+            set_terms4(batch, i, terms);
+
+            for (int k = 0; k < 4; ++k)
+                out[i + k] = finish(batch, i + k, terms[k], th);
+        }
+#endif
+
+        for (; i < batch.size(); ++i)
+            out[i] = finish(batch, i, set_terms(batch, i), th);
+    }
+
+    void evaluate_file(const std::string& fileName, bool quiet, bool check)
+    {
+        std::ifstream file(fileName);
+        if (!file)
+        {
+            std::cout << "info string Cannot open " << fileName << std::endl;
+            return;
+        }
+
+        typedef std::chrono::steady_clock Clock;
+        const size_t ChunkSize = 16384;
+
+        Batch batch;
+        std::vector<std::string> fens;
+        std::vector<Value> values(ChunkSize), single(ChunkSize);
+        uint64_t positions = 0, skipped = 0, mismatches = 0;
+        int64_t parseNs = 0, evalNs = 0, referenceNs = 0;
+
+        batch.reserve(ChunkSize);
+
+        for (bool more = true; more; )
+        {
+            batch.clear();
+            fens.clear();
+
+            std::string line;
+            Clock::time_point t0 = Clock::now();
+
+            while (batch.size() < ChunkSize && (more = bool(std::getline(file, line))))
+                if (batch.add(line))
+                {
+                    if (check)
+                        fens.push_back(line);
+                }
+                else if (!line.empty())
+                    ++skipped;
+
+            Clock::time_point t1 = Clock::now();
+            evaluate(batch, values.data(), Threads);
+            Clock::time_point t2 = Clock::now();
+
+            parseNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            evalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+            positions += batch.size();
+
+            if (check)
+            {
+                for (std::string& fen : fens)
+                {
+                    std::istringstream ss(fen);
+                    std::string fields[4] = { "", "", "-", "-" };
+                    ss >> fields[0] >> fields[1] >> fields[2] >> fields[3];
+                    fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + " 0 1";
+                }
+
+                Clock::time_point t3 = Clock::now();
+
+                for (size_t i = 0; i < fens.size(); ++i)
+                {
+                    Position pos;
+                    StateInfo st;
+                    single[i] = Eval::evaluate_full(pos.set(fens[i], false, &st, Threads));
+                }
+
+                referenceNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t3).count();
+
+                for (size_t i = 0; i < fens.size(); ++i)
+                    if (single[i] != values[i] && ++mismatches <= 10)
+                        std::cout << "info string Mismatch " << fens[i] << " batch " << values[i]
+                            << " single " << single[i] << std::endl;
+            }
+
+            if (!quiet)
+            {
+                std::ostringstream os;
+                for (size_t i = 0; i < batch.size(); ++i)
+                    os << values[i] << '\n';
+                std::cout << os.str() << std::flush;
+            }
+        }
+
+        uint64_t n = std::max(positions, uint64_t(1));
+
+        std::cout << "info string evalbatch positions " << positions << " skipped " << skipped
+            << " parse " << parseNs / n << " ns/pos eval " << evalNs / n << " ns/pos"
+            << " total " << (parseNs + evalNs) / 1000000 << " ms (" << batch_simd_name() << ")" << std::endl;
+
+        if (check)
+            std::cout << "info string evalbatch single set+evaluate " << referenceNs / n << " ns/pos"
+                << " speedup " << double(referenceNs) / std::max(parseNs + evalNs, int64_t(1))
+                << " mismatches " << mismatches << std::endl;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef EVAL_BATCH_H
+#define EVAL_BATCH_H
+
+#include "types.h"
+#include <string>
+#include <vector>
+
+class Position;
+class Thread;
+
+namespace Eval
+{
+    // Many positions stored structure-of-arrays: bb[c][pt][i] holds colour
+    // c's pieces of type pt in position i, and bb[c][NO_PIECE_TYPE][i] all of
+    // colour c's pieces. Only what the classical evaluation reads is kept, so
+    // filling a batch from FENs costs far less than Position::set.
+    struct Batch
+    {
+        void clear();
+        void reserve(size_t n);
+        size_t size() const { return sideToMove.size(); }
+
+        // Reads the board and side to move of a FEN; anything after them is
+        // ignored. Returns false and leaves the batch unchanged if either is
+        // malformed or a side does not have exactly one king.
+        bool add(const std::string& fen);
+        void add(const Position& pos);
+
+        std::vector<Bitboard> bb[COLOR_NB][PIECE_TYPE_NB];
+        std::vector<uint8_t> sideToMove;
+    };
+
+    // Sets out[i] to what evaluate() returns for position i of the batch,
+    // side to move's point of view. Pawn and material entries come from th's
+    // tables. Attack maps, mobility and threats are computed four positions
+    // at a time with AVX2 when built for it.
+    void evaluate(const Batch& batch, Value* out, Thread* th);
+    const char* batch_simd_name();
+
+    // evalbatch: evaluates every position of an EPD file through a batch,
+    // printing one value per line unless quiet. With check each position is
+    // also set up and evaluated one at a time, for timing and comparison,
+    // with the same Full configuration and no cache or EGTB.
+    void evaluate_file(const std::string& fileName, bool quiet, bool check);
+}
+
+#endif
@@ -2,153 +2,10 @@
 #include "eval.h"
 #include "board.h"
 #include "bitboard.h"
+#include "pawns.h"
 
 namespace Eval
 {
-    const Value PawnTableMG[64] =
-    {
-        0,   0,   0,   0,   0,   0,   0,   0,
-        5,  10,  15,  20,  20,  15,  10,   5,
-       -5,   0,  10,  25,  25,  10,   0,  -5,
-      -10,   0,  10,  25,  25,  10,   0, -10,
-      -15,  -5,   5,  20,  20,   5,  -5, -15,
-      -20, -10,   0,   5,   5,   0, -10, -20,
-      -25, -15,  -5,   0,   0,  -5, -15, -25,
-        0,   0,   0,   0,   0,   0,   0,   0
-    };
-
-    const Value PawnTableEG[64] =
-    {
-        0,   0,   0,   0,   0,   0,   0,   0,
-      180, 175, 160, 135, 135, 160, 175, 180,
-       95, 100,  85,  70,  70,  85, 100,  95,
-       35,  25,  15,   5,   5,  15,  25,  35,
-       15,  10,   0,  -5,  -5,   0,  10,  15,
-        5,   5,  -5,   0,   0,  -5,   5,   5,
-       15,  10,  10,  15,  15,  10,  10,  15,
-        0,   0,   0,   0,   0,   0,   0,   0
-    };
-
-    const Value KnightTableMG[64] =
-    {
-     -150, -100, -80, -80, -80, -80, -100, -150,
-      -100,  -50, -20, -10, -10, -20,  -50, -100,
-       -80,  -20,   0,   5,   5,   0,  -20,  -80,
-       -80,  -10,   5,  10,  10,   5,  -10,  -80,
-       -80,  -10,   5,  10,  10,   5,  -10,  -80,
-       -80,  -20,   0,   5,   5,   0,  -20,  -80,
-      -100,  -50, -20, -10, -10, -20,  -50, -100,
-      -200, -150, -120, -120, -120, -120, -150, -200
-    };
-
-    const Value KnightTableEG[64] =
-    {
-      -50, -40, -30, -30, -30, -30, -40, -50,
-      -30, -20, -10, -10, -10, -10, -20, -30,
-      -20, -10,   0,   5,   5,   0, -10, -20,
-      -15,  -5,   5,  10,  10,   5,  -5, -15,
-      -15,  -5,   5,  10,  10,   5,  -5, -15,
-      -20, -10,   0,   5,   5,   0, -10, -20,
-      -30, -20, -10, -10, -10, -10, -20, -30,
-      -50, -40, -30, -30, -30, -30, -40, -50
-    };
-
-    const Value BishopTableMG[64] =
-    {
-      -20, -10, -10, -10, -10, -10, -10, -20,
-      -10,   5,   0,   0,   0,   0,   5, -10,
-      -10,  10,  10,  10,  10,  10,  10, -10,
-      -10,   0,  10,  10,  10,  10,   0, -10,
-      -10,   5,   5,  10,  10,   5,   5, -10,
-      -10,   0,   5,  10,  10,   5,   0, -10,
-      -10,   0,   0,   0,   0,   0,   0, -10,
-      -20, -10, -10, -10, -10, -10, -10, -20
-    };
-
-    const Value BishopTableEG[64] =
-    {
-      -15, -10, -10, -10, -10, -10, -10, -15,
-      -10,   0,   0,   0,   0,   0,   0, -10,
-      -10,   0,   5,  10,  10,   5,   0, -10,
-      -10,   5,   5,  10,  10,   5,   5, -10,
-      -10,   0,  10,  10,  10,  10,   0, -10,
-      -10,  10,  10,  10,  10,  10,  10, -10,
-      -10,   5,   0,   0,   0,   0,   5, -10,
-      -15, -10, -10, -10, -10, -10, -10, -15
-    };
-
-    const Value RookTableMG[64] =
-    {
-        0,   0,   0,   5,   5,   0,   0,   0,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-        5,  10,  10,  10,  10,  10,  10,   5,
-        0,   0,   0,   0,   0,   0,   0,   0
-    };
-
-    const Value RookTableEG[64] =
-    {
-        0,   0,   0,   0,   0,   0,   0,   0,
-        5,  10,  10,  10,  10,  10,  10,   5,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-       -5,   0,   0,   0,   0,   0,   0,  -5,
-        0,   0,   0,   0,   0,   0,   0,   0
-    };
-
-    const Value QueenTableMG[64] =
-    {
-      -20, -10, -10,  -5,  -5, -10, -10, -20,
-      -10,   0,   5,   0,   0,   0,   0, -10,
-      -10,   5,   5,   5,   5,   5,   0, -10,
-        0,   0,   5,   5,   5,   5,   0,  -5,
-       -5,   0,   5,   5,   5,   5,   0,  -5,
-      -10,   0,   5,   5,   5,   5,   0, -10,
-      -10,   0,   0,   0,   0,   0,   0, -10,
-      -20, -10, -10,  -5,  -5, -10, -10, -20
-    };
-
-    const Value QueenTableEG[64] =
-    {
-      -20, -10, -10,  -5,  -5, -10, -10, -20,
-      -10,   0,   0,   0,   0,   0,   0, -10,
-      -10,   0,   5,   5,   5,   5,   0, -10,
-       -5,   0,   5,   5,   5,   5,   0,  -5,
-        0,   0,   5,   5,   5,   5,   0,   0,
-      -10,   5,   5,   5,   5,   5,   0, -10,
-      -10,   0,   5,   0,   0,   0,   0, -10,
-      -20, -10, -10,  -5,  -5, -10, -10, -20
-    };
-
-    const Value KingTableMG[64] =
-    {
-       20,  30,  10,   0,   0,  10,  30,  20,
-       20,  20,   0,   0,   0,   0,  20,  20,
-      -10, -20, -20, -20, -20, -20, -20, -10,
-      -20, -30, -30, -40, -40, -30, -30, -20,
-      -30, -40, -40, -50, -50, -40, -40, -30,
-      -30, -40, -40, -50, -50, -40, -40, -30,
-      -30, -40, -40, -50, -50, -40, -40, -30,
-      -30, -40, -40, -50, -50, -40, -40, -30
-    };
-
-    const Value KingTableEG[64] =
-    {
-      -50, -30, -30, -30, -30, -30, -30, -50,
-      -30, -30,   0,   0,   0,   0, -30, -30,
-      -30, -10,  20,  30,  30,  20, -10, -30,
-      -30, -10,  30,  40,  40,  30, -10, -30,
-      -30, -10,  30,  40,  40,  30, -10, -30,
-      -30, -10,  20,  30,  30,  20, -10, -30,
-      -30, -20, -10,   0,   0, -10, -20, -30,
-      -50, -40, -30, -20, -20, -30, -40, -50
-    };
-
     Value evaluatePieceSquare(Piece pc, Square sq, bool isEndgame)
     {
         PieceType pt = type_of(pc);
@@ -171,145 +28,81 @@ namespace Eval
         return table[relativeSquare];
     }
 
-    Value evaluateCenter(const Position& pos)
-    {
-        Value value = 0;
-
-        if (pos.piece_on(SQ_E4) == W_PAWN) value += 20;
-        if (pos.piece_on(SQ_D4) == W_PAWN) value += 20;
-        if (pos.piece_on(SQ_E5) == B_PAWN) value -= 20;
-        if (pos.piece_on(SQ_D5) == B_PAWN) value -= 20;
-
-        if (pos.piece_on(SQ_E3) == W_PAWN) value += 10;
-        if (pos.piece_on(SQ_D3) == W_PAWN) value += 10;
-        if (pos.piece_on(SQ_E6) == B_PAWN) value -= 10;
-        if (pos.piece_on(SQ_D6) == B_PAWN) value -= 10;
-
-        return value;
-    }
-
-    Value evaluateKnightPenalties(const Position& pos)
+    // Middlegame bonuses for particular squares, from White's side of the
+    // board: central pawns, and knights on or off their best squares.
+    Value squareBonus(PieceType pt, Square s)
     {
-        Value value = 0;
-
-        if (pos.piece_on(SQ_A3) == W_KNIGHT) value -= 50;  //  
-        if (pos.piece_on(SQ_H3) == W_KNIGHT) value -= 50;
-        if (pos.piece_on(SQ_A6) == B_KNIGHT) value += 50;
-        if (pos.piece_on(SQ_H6) == B_KNIGHT) value += 50;
+        if (pt == PAWN)
+            return s == SQ_D4 || s == SQ_E4 ? 20
+                : s == SQ_D3 || s == SQ_E3 ? 10 : 0;
 
-        if (pos.piece_on(SQ_A1) == W_KNIGHT) value -= 100; //   
-        if (pos.piece_on(SQ_H1) == W_KNIGHT) value -= 100;
-        if (pos.piece_on(SQ_A8) == B_KNIGHT) value += 100;
-        if (pos.piece_on(SQ_H8) == B_KNIGHT) value += 100;
+        if (pt == KNIGHT)
+            return s == SQ_A1 || s == SQ_H1 ? -100
+                : s == SQ_A3 || s == SQ_H3 ? -50
+                : s == SQ_C3 || s == SQ_F3 ? 30 : 0;
 
-        if (pos.piece_on(SQ_C3) == W_KNIGHT) value += 30;
-        if (pos.piece_on(SQ_F3) == W_KNIGHT) value += 30;
-        if (pos.piece_on(SQ_C6) == B_KNIGHT) value -= 30;
-        if (pos.piece_on(SQ_F6) == B_KNIGHT) value -= 30;
-
-        return value;
+        return 0;
     }
 
-    Value evaluateKingSafety(const Position& pos)
+    // One pass over the piece bitboards of each side fills the attack maps
+    // and sums mobility; pawn attacks come from the pawn hash entry.
+    template<Color Us>
+    static void evaluatePieces(const Position& pos, EvalInfo& ei)
     {
-        Value value = 0;
+        Bitboard occupied = pos.pieces();
+        Bitboard ownPieces = pos.pieces(Us);
+        Value mobility = 0;
 
-        Square whiteKing = pos.square<KING>(WHITE);
-        Square blackKing = pos.square<KING>(BLACK);
+        ei.attackedBy[Us][KING] = king_attacks_bb(pos.square<KING>(Us));
+        ei.attackedBy[Us][NO_PIECE_TYPE] = ei.attackedBy[Us][PAWN] | ei.attackedBy[Us][KING];
 
-        if (rank_of(whiteKing) == RANK_1)
+        for (PieceType pt = KNIGHT; pt <= QUEEN; pt = PieceType(pt + 1))
         {
-            File f = file_of(whiteKing);
-            int shield = 0;
-
-            if (f > FILE_A && pos.piece_on(make_square(File(f - 1), RANK_2)) == W_PAWN) shield++;
-            if (pos.piece_on(make_square(f, RANK_2)) == W_PAWN) shield++;
-            if (f < FILE_H && pos.piece_on(make_square(File(f + 1), RANK_2)) == W_PAWN) shield++;
-
-            value += shield * 10;
-        }
+            Bitboard pieces = pos.pieces(Us, pt);
+            ei.attackedBy[Us][pt] = 0;
 
-        if (rank_of(blackKing) == RANK_8)
-        {
-            File f = file_of(blackKing);
-            int shield = 0;
+            while (pieces)
+            {
+                Bitboard attacks = attacks_bb(pt, pop_lsb(pieces), occupied);
 
-            if (f > FILE_A && pos.piece_on(make_square(File(f - 1), RANK_7)) == B_PAWN) shield++;
-            if (pos.piece_on(make_square(f, RANK_7)) == B_PAWN) shield++;
-            if (f < FILE_H && pos.piece_on(make_square(File(f + 1), RANK_7)) == B_PAWN) shield++;
+                ei.attackedBy[Us][pt] |= attacks;
+                mobility += popcount(attacks & ~ownPieces) * MobilityWeight[pt];
+            }
 
-            value -= shield * 10;
+            ei.attackedBy[Us][NO_PIECE_TYPE] |= ei.attackedBy[Us][pt];
         }
 
-        return value;
+        ei.mobility[Us] = mobility;
     }
 
-    Value evaluateMobility(const Position& pos)
+    void initEvalInfo(const Position& pos, const Pawns::Entry* pe, EvalInfo& ei)
     {
-        Value value = 0;
-
-        for (Square s = SQ_A1; s <= SQ_H8; s = Square(s + 1))
-        {
-            Piece pc = pos.piece_on(s);
-            if (pc == NO_PIECE) continue;
-
-            PieceType pt = type_of(pc);
-            Color c = color_of(pc);
+        ei.attackedBy[WHITE][PAWN] = pe->pawn_attacks(WHITE);
+        ei.attackedBy[BLACK][PAWN] = pe->pawn_attacks(BLACK);
 
-            if (pt == KNIGHT || pt == BISHOP || pt == ROOK || pt == QUEEN)
-            {
-                Bitboard attacks = attacks_bb(pt, s, pos.pieces());
-                attacks &= ~pos.pieces(c);
-
-                int mobility = popcount(attacks);
-                Value mobilityBonus = mobility * (pt == QUEEN ? 1 : pt == ROOK ? 1 : 2);
-
-                if (c == WHITE)
-                    value += mobilityBonus;
-                else
-                    value -= mobilityBonus;
-            }
-        }
-
-        return value;
+        evaluatePieces<WHITE>(pos, ei);
+        evaluatePieces<BLACK>(pos, ei);
     }
 
-    Value evaluateThreats(const Position& pos)
+    // A piece attacked by the opponent and not defended at all is hanging.
+    template<Color Us>
+    static Value hangingPenalty(const Position& pos, const EvalInfo& ei)
     {
-        Value value = 0;
+        const Color Them = ~Us;
 
-        for (Square s = SQ_A1; s <= SQ_H8; s = Square(s + 1))
-        {
-            Piece pc = pos.piece_on(s);
-            if (pc == NO_PIECE) continue;
+        Bitboard hanging = pos.pieces(Us) & ei.attackedBy[Them][NO_PIECE_TYPE]
+            & ~ei.attackedBy[Us][NO_PIECE_TYPE];
 
-            Color c = color_of(pc);
-            Color enemy = ~c;
-            PieceType pt = type_of(pc);
+        Value penalty = 0;
 
-            Bitboard attackers = pos.attackers_to(s) & pos.pieces(enemy);
-            Bitboard defenders = pos.attackers_to(s) & pos.pieces(c);
+        for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+            penalty += HangingPenalty[pt] * popcount(hanging & pos.pieces(Us, pt));
 
-            if (attackers && !defenders)
-            {
-                Value penalty = 0;
-                switch (pt)
-                {
-                case PAWN:   penalty = 15; break;
-                case KNIGHT: penalty = 60; break;
-                case BISHOP: penalty = 60; break;
-                case ROOK:   penalty = 80; break;
-                case QUEEN:  penalty = 120; break;
-                default: break;
-                }
-
-                if (c == WHITE)
-                    value -= penalty;
-                else
-                    value += penalty;
-            }
-        }
+        return penalty;
+    }
 
-        return value;
+    Value evaluateThreats(const Position& pos, const EvalInfo& ei)
+    {
+        return hangingPenalty<BLACK>(pos, ei) - hangingPenalty<WHITE>(pos, ei);
     }
 }
\ No newline at end of file
@@ -5,14 +5,50 @@
 
 class Position;
 
+namespace Pawns { struct Entry; }
+namespace Material { struct Entry; }
+
 namespace Eval
 {
+    // Attack maps and mobility built once per evaluation and shared by every
+    // term. attackedBy[c][NO_PIECE_TYPE] is the union of all of c's attacks.
+    struct EvalInfo
+    {
+        Bitboard attackedBy[COLOR_NB][PIECE_TYPE_NB];
+        Value mobility[COLOR_NB];
+    };
+
+    // Tunable weights, defined in eval_params.cpp. Piece-square tables are
+    // indexed by the square from the piece owner's side.
+    extern const Value PawnTableMG[SQUARE_NB];
+    extern const Value PawnTableEG[SQUARE_NB];
+    extern const Value KnightTableMG[SQUARE_NB];
+    extern const Value KnightTableEG[SQUARE_NB];
+    extern const Value BishopTableMG[SQUARE_NB];
+    extern const Value BishopTableEG[SQUARE_NB];
+    extern const Value RookTableMG[SQUARE_NB];
+    extern const Value RookTableEG[SQUARE_NB];
+    extern const Value QueenTableMG[SQUARE_NB];
+    extern const Value QueenTableEG[SQUARE_NB];
+    extern const Value KingTableMG[SQUARE_NB];
+    extern const Value KingTableEG[SQUARE_NB];
+
+    extern const Score Tempo;
+
+    // Per attacked square not holding a friendly piece.
+    extern const Value MobilityWeight[PIECE_TYPE_NB];
+
+    // Per undefended piece attacked by the opponent.
+    extern const Value HangingPenalty[PIECE_TYPE_NB];
+
+    // Phase-blended, scaled value of a White-POV score, from stm's point of
+    // view.
+    Value blend(const Material::Entry* me, Score score, Color stm, bool oppositeBishops);
+
     Value evaluatePieceSquare(Piece pc, Square sq, bool isEndgame);
-    Value evaluateCenter(const Position& pos);
-    Value evaluateKnightPenalties(const Position& pos);
-    Value evaluateKingSafety(const Position& pos);
-    Value evaluateMobility(const Position& pos);
-    Value evaluateThreats(const Position& pos);
+    Value squareBonus(PieceType pt, Square s);
+    void initEvalInfo(const Position& pos, const Pawns::Entry* pe, EvalInfo& ei);
+    Value evaluateThreats(const Position& pos, const EvalInfo& ei);
 }
 
 #endif
\ No newline at end of file
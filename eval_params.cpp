@@ -0,0 +1,157 @@
+#include "eval.h"
+#include "eval_features.h"
+
+// Evaluation weights. "tune" writes a replacement for this file in the same
+// layout, so hand edits should keep to it.
+namespace Eval
+{
+    const Value PieceValuesMG[PIECE_TYPE_NB] = { 0, 124, 781, 825, 1276, 2538, 0 };
+    const Value PieceValuesEG[PIECE_TYPE_NB] = { 0, 206, 854, 915, 1380, 2682, 0 };
+
+    const Value PawnTableMG[SQUARE_NB] =
+    {
+        0,   0,   0,   0,   0,   0,   0,   0,
+        5,  10,  15,  20,  20,  15,  10,   5,
+       -5,   0,  10,  25,  25,  10,   0,  -5,
+      -10,   0,  10,  25,  25,  10,   0, -10,
+      -15,  -5,   5,  20,  20,   5,  -5, -15,
+      -20, -10,   0,   5,   5,   0, -10, -20,
+      -25, -15,  -5,   0,   0,  -5, -15, -25,
+        0,   0,   0,   0,   0,   0,   0,   0
+    };
+
+    const Value PawnTableEG[SQUARE_NB] =
+    {
+        0,   0,   0,   0,   0,   0,   0,   0,
+      180, 175, 160, 135, 135, 160, 175, 180,
+       95, 100,  85,  70,  70,  85, 100,  95,
+       35,  25,  15,   5,   5,  15,  25,  35,
+       15,  10,   0,  -5,  -5,   0,  10,  15,
+        5,   5,  -5,   0,   0,  -5,   5,   5,
+       15,  10,  10,  15,  15,  10,  10,  15,
+        0,   0,   0,   0,   0,   0,   0,   0
+    };
+
+    const Value KnightTableMG[SQUARE_NB] =
+    {
+      -150, -100, -80, -80, -80, -80, -100, -150,
+      -100, -50, -20, -10, -10, -20, -50, -100,
+      -80, -20,   0,   5,   5,   0, -20, -80,
+      -80, -10,   5,  10,  10,   5, -10, -80,
+      -80, -10,   5,  10,  10,   5, -10, -80,
+      -80, -20,   0,   5,   5,   0, -20, -80,
+      -100, -50, -20, -10, -10, -20, -50, -100,
+      -200, -150, -120, -120, -120, -120, -150, -200
+    };
+
+    const Value KnightTableEG[SQUARE_NB] =
+    {
+      -50, -40, -30, -30, -30, -30, -40, -50,
+      -30, -20, -10, -10, -10, -10, -20, -30,
+      -20, -10,   0,   5,   5,   0, -10, -20,
+      -15,  -5,   5,  10,  10,   5,  -5, -15,
+      -15,  -5,   5,  10,  10,   5,  -5, -15,
+      -20, -10,   0,   5,   5,   0, -10, -20,
+      -30, -20, -10, -10, -10, -10, -20, -30,
+      -50, -40, -30, -30, -30, -30, -40, -50
+    };
+
+    const Value BishopTableMG[SQUARE_NB] =
+    {
+      -20, -10, -10, -10, -10, -10, -10, -20,
+      -10,   5,   0,   0,   0,   0,   5, -10,
+      -10,  10,  10,  10,  10,  10,  10, -10,
+      -10,   0,  10,  10,  10,  10,   0, -10,
+      -10,   5,   5,  10,  10,   5,   5, -10,
+      -10,   0,   5,  10,  10,   5,   0, -10,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -20, -10, -10, -10, -10, -10, -10, -20
+    };
+
+    const Value BishopTableEG[SQUARE_NB] =
+    {
+      -15, -10, -10, -10, -10, -10, -10, -15,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -10,   0,   5,  10,  10,   5,   0, -10,
+      -10,   5,   5,  10,  10,   5,   5, -10,
+      -10,   0,  10,  10,  10,  10,   0, -10,
+      -10,  10,  10,  10,  10,  10,  10, -10,
+      -10,   5,   0,   0,   0,   0,   5, -10,
+      -15, -10, -10, -10, -10, -10, -10, -15
+    };
+
+    const Value RookTableMG[SQUARE_NB] =
+    {
+        0,   0,   0,   5,   5,   0,   0,   0,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+        5,  10,  10,  10,  10,  10,  10,   5,
+        0,   0,   0,   0,   0,   0,   0,   0
+    };
+
+    const Value RookTableEG[SQUARE_NB] =
+    {
+        0,   0,   0,   0,   0,   0,   0,   0,
+        5,  10,  10,  10,  10,  10,  10,   5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+        0,   0,   0,   0,   0,   0,   0,   0
+    };
+
+    const Value QueenTableMG[SQUARE_NB] =
+    {
+      -20, -10, -10,  -5,  -5, -10, -10, -20,
+      -10,   0,   5,   0,   0,   0,   0, -10,
+      -10,   5,   5,   5,   5,   5,   0, -10,
+        0,   0,   5,   5,   5,   5,   0,  -5,
+       -5,   0,   5,   5,   5,   5,   0,  -5,
+      -10,   0,   5,   5,   5,   5,   0, -10,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -20, -10, -10,  -5,  -5, -10, -10, -20
+    };
+
+    const Value QueenTableEG[SQUARE_NB] =
+    {
+      -20, -10, -10,  -5,  -5, -10, -10, -20,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -10,   0,   5,   5,   5,   5,   0, -10,
+       -5,   0,   5,   5,   5,   5,   0,  -5,
+        0,   0,   5,   5,   5,   5,   0,   0,
+      -10,   5,   5,   5,   5,   5,   0, -10,
+      -10,   0,   5,   0,   0,   0,   0, -10,
+      -20, -10, -10,  -5,  -5, -10, -10, -20
+    };
+
+    const Value KingTableMG[SQUARE_NB] =
+    {
+       20,  30,  10,   0,   0,  10,  30,  20,
+       20,  20,   0,   0,   0,   0,  20,  20,
+      -10, -20, -20, -20, -20, -20, -20, -10,
+      -20, -30, -30, -40, -40, -30, -30, -20,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30
+    };
+
+    const Value KingTableEG[SQUARE_NB] =
+    {
+      -50, -30, -30, -30, -30, -30, -30, -50,
+      -30, -30,   0,   0,   0,   0, -30, -30,
+      -30, -10,  20,  30,  30,  20, -10, -30,
+      -30, -10,  30,  40,  40,  30, -10, -30,
+      -30, -10,  30,  40,  40,  30, -10, -30,
+      -30, -10,  20,  30,  30,  20, -10, -30,
+      -30, -20, -10,   0,   0, -10, -20, -30,
+      -50, -40, -30, -20, -20, -30, -40, -50
+    };
+
+    const Value MobilityWeight[PIECE_TYPE_NB] = { 0, 0, 2, 2, 1, 1, 0 };
+    const Value HangingPenalty[PIECE_TYPE_NB] = { 0, 15, 60, 60, 80, 120, 0 };
+}
@@ -4,6 +4,7 @@
 #include "uci.h"
 #include "search.h"
 #include "eval.h"
+#include "endgame.h"
 
 int main(int argc, char* argv[])
 {
@@ -11,8 +12,10 @@ int main(int argc, char* argv[])
 
     init_bitboards();
     Position::init();
-    Search::init();
     Eval::init();
+    Bitbases::init();
+    Endgames::init();
+    Search::init();
     UCI::init();
 
     UCI::loop(argc, argv);
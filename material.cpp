@@ -0,0 +1,140 @@
+#include "material.h"
+#include "board.h"
+#include "eval.h"
+#include "search.h"
+
+namespace Material
+{
+    const int PiecePhase[PIECE_TYPE_NB] = { 0, 0, 1, 1, 2, 4, 0 };
+    const int MaxPhase = 24;
+
+    const Value BishopPairMG = 30, BishopPairEG = 50;
+
+    // Knights gain and rooks lose value as pawns come off, per pawn away from five
+    const Value KnightPawnAdjust = 6;
+    const Value RookPawnAdjust = 12;
+
+    namespace
+    {
+        int non_pawn_material(const Counts& n, Color c)
+        {
+            return n[c][KNIGHT] * Eval::PieceValuesMG[KNIGHT]
+                + n[c][BISHOP] * Eval::PieceValuesMG[BISHOP]
+                + n[c][ROOK] * Eval::PieceValuesMG[ROOK]
+                + n[c][QUEEN] * Eval::PieceValuesMG[QUEEN];
+        }
+
+        // Generic mating material against a bare king
+        bool is_KXK(const Counts& n, Color us)
+        {
+            int theirPieces = 0;
+            for (PieceType pt = PAWN; pt <= KING; ++pt)
+                theirPieces += n[~us][pt];
+
+            return theirPieces <= 1 && non_pawn_material(n, us) >= Eval::PieceValuesMG[ROOK];
+        }
+
+        template<Color Us>
+        int imbalance(const Counts& n, bool isEndgame)
+        {
+            int pawns = n[Us][PAWN];
+            int v = 0;
+
+            if (n[Us][BISHOP] >= 2)
+                v += isEndgame ? BishopPairEG : BishopPairMG;
+
+            v += n[Us][KNIGHT] * KnightPawnAdjust * (pawns - 5);
+            v -= n[Us][ROOK] * RookPawnAdjust * (pawns - 5);
+
+            return v;
+        }
+    }
+
+    ScaleFactor Entry::scale_factor(const Position& pos, Color c) const
+    {
+        if (factor[c] == SCALE_FACTOR_NORMAL && oppositeBishopsFactor != SCALE_FACTOR_NONE)
+            return scale_factor(c, pos.opposite_bishops());
+
+        return factor[c];
+    }
+
+    ScaleFactor Entry::scale_factor(Color c, bool oppositeBishops) const
+    {
+        if (factor[c] == SCALE_FACTOR_NORMAL && oppositeBishopsFactor != SCALE_FACTOR_NONE && oppositeBishops)
+            return oppositeBishopsFactor;
+
+        return factor[c];
+    }
+
+    Entry* probe(const Position& pos)
+    {
+        Key key = pos.material_key();
+        Entry* e = pos.this_thread()->materialTable[key];
+
+        if (e->key == key)
+            return e;
+
+        Counts n;
+        for (Color c = WHITE; c <= BLACK; ++c)
+        {
+            n[c][NO_PIECE_TYPE] = 0;
+            for (PieceType pt = PAWN; pt <= KING; ++pt)
+                n[c][pt] = popcount(pos.pieces(c, pt));
+        }
+
+        return probe(pos.this_thread()->materialTable, key, n);
+    }
+
+    Entry* probe(Table& table, Key key, const Counts& n)
+    {
+        Entry* e = table[key];
+
+        if (e->key == key)
+            return e;
+
+        e->key = key;
+        e->endgame = Endgames::probe(key);
+        e->factor[WHITE] = e->factor[BLACK] = SCALE_FACTOR_NORMAL;
+        e->oppositeBishopsFactor = SCALE_FACTOR_NONE;
+
+        int phase = 0;
+        for (Color c = WHITE; c <= BLACK; ++c)
+            phase += n[c][KNIGHT] * PiecePhase[KNIGHT]
+                + n[c][BISHOP] * PiecePhase[BISHOP]
+                + n[c][ROOK] * PiecePhase[ROOK]
+                + n[c][QUEEN] * PiecePhase[QUEEN];
+
+        e->gamePhase = std::min(phase, MaxPhase);
+        e->imbalanceScore = make_score(imbalance<WHITE>(n, false) - imbalance<BLACK>(n, false),
+            imbalance<WHITE>(n, true) - imbalance<BLACK>(n, true));
+
+        if (!e->endgame)
+            for (Color c = WHITE; c <= BLACK; ++c)
+                if (is_KXK(n, c))
+                {
+                    static const Endgames::Endgame KXK[COLOR_NB] = { { Endgames::KXK, WHITE }, { Endgames::KXK, BLACK } };
+                    e->endgame = &KXK[c];
+                    return e;
+                }
+
+        const int npmW = non_pawn_material(n, WHITE);
+        const int npmB = non_pawn_material(n, BLACK);
+
+        // Without pawns a small material edge is rarely enough to win
+        if (!n[WHITE][PAWN] && npmW - npmB <= Eval::PieceValuesMG[BISHOP])
+            e->factor[WHITE] = ScaleFactor(npmW < Eval::PieceValuesMG[ROOK] ? SCALE_FACTOR_DRAW :
+                npmB <= Eval::PieceValuesMG[BISHOP] ? 4 : 14);
+
+        if (!n[BLACK][PAWN] && npmB - npmW <= Eval::PieceValuesMG[BISHOP])
+            e->factor[BLACK] = ScaleFactor(npmB < Eval::PieceValuesMG[ROOK] ? SCALE_FACTOR_DRAW :
+                npmW <= Eval::PieceValuesMG[BISHOP] ? 4 : 14);
+
+        // One bishop each: drawish if they turn out to be on opposite colours,
+        // strongly so when nothing else is left besides pawns.
+        if (n[WHITE][BISHOP] == 1 && n[BLACK][BISHOP] == 1)
+            e->oppositeBishopsFactor = ScaleFactor(npmW == Eval::PieceValuesMG[BISHOP]
+                && npmB == Eval::PieceValuesMG[BISHOP] ? 22 : 46);
+
+        return e;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "types.h"
+#include "endgame.h"
+
+class Position;
+
+namespace Material
+{
+    // Everything that depends only on the piece counts of both sides: game
+    // phase, imbalance (White's point of view), endgame scaling and, for
+    // known endgames, a specialised evaluation function.
+    struct Entry
+    {
+        int game_phase() const { return gamePhase; }
+        Score imbalance() const { return imbalanceScore; }
+
+        bool specialized_eval_exists() const { return endgame != nullptr; }
+        Value evaluate(const Position& pos) const { return endgame->fn(pos, endgame->strongSide); }
+
+        // Scale for the endgame score when c is the side ahead. Opposite
+        // bishops depend on bishop squares, so only the factor to use is
+        // cached and the squares are checked here.
+        ScaleFactor scale_factor(const Position& pos, Color c) const;
+        ScaleFactor scale_factor(Color c, bool oppositeBishops) const;
+
+        Key key;
+        const Endgames::Endgame* endgame;
+        int gamePhase;
+        Score imbalanceScore;
+        ScaleFactor factor[COLOR_NB];
+        ScaleFactor oppositeBishopsFactor;
+    };
+
+    typedef HashTable<Entry, 8192> Table;
+
+    // Piece counts by colour and type; the NO_PIECE_TYPE slot is unused.
+    typedef int Counts[COLOR_NB][PIECE_TYPE_NB];
+
+    Entry* probe(const Position& pos);
+
+    // Same entry as probe(pos) for a position with material key key and
+    // counts n, for callers that have no Position to hand.
+    Entry* probe(Table& table, Key key, const Counts& n);
+}
+
+#endif
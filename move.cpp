@@ -139,98 +139,15 @@ ExtMove* generate<LEGAL>(const Position& pos, ExtMove* moveList)
                 }
             }
         }
-        else if (pt == BISHOP)
+        else if (pt == BISHOP || pt == ROOK || pt == QUEEN)
         {
-            int directions[] = { -9, -7, 7, 9 };
-            for (int dir : directions)
-            {
-                for (Square to = Square(from + dir); is_ok(to) && distance(from, to) <= 7; to = Square(to + dir))
-                {
-                    int fileDiff = abs(int(file_of(to)) - int(file_of(from)));
-                    int rankDiff = abs(int(rank_of(to)) - int(rank_of(from)));
+            Bitboard targets = attacks_bb(pt, from, pos.pieces()) & ~pos.pieces(us);
 
-                    if (fileDiff != rankDiff)
-                        break;
-
-                    Piece captured = pos.piece_on(to);
-                    if (captured != NO_PIECE)
-                    {
-                        if (color_of(captured) != us)
-                        {
-                            cur->move = make_move(from, to);
-                            cur->value = VALUE_ZERO;
-                            ++cur;
-                        }
-                        break;
-                    }
-
-                    cur->move = make_move(from, to);
-                    cur->value = VALUE_ZERO;
-                    ++cur;
-                }
-            }
-        }
-        else if (pt == ROOK)
-        {
-            int directions[] = { -8, -1, 1, 8 };
-            for (int dir : directions)
+            while (targets)
             {
-                for (Square to = Square(from + dir); is_ok(to) && distance(from, to) <= 7; to = Square(to + dir))
-                {
-                    int fileDiff = abs(int(file_of(to)) - int(file_of(from)));
-                    int rankDiff = abs(int(rank_of(to)) - int(rank_of(from)));
-
-                    if ((fileDiff != 0 && rankDiff != 0))
-                        break;
-
-                    Piece captured = pos.piece_on(to);
-                    if (captured != NO_PIECE)
-                    {
-                        if (color_of(captured) != us)
-                        {
-                            cur->move = make_move(from, to);
-                            cur->value = VALUE_ZERO;
-                            ++cur;
-                        }
-                        break;
-                    }
-
-                    cur->move = make_move(from, to);
-                    cur->value = VALUE_ZERO;
-                    ++cur;
-                }
-            }
-        }
-        else if (pt == QUEEN)
-        {
-            int directions[] = { -9, -8, -7, -1, 1, 7, 8, 9 };
-            for (int dir : directions)
-            {
-                for (Square to = Square(from + dir); is_ok(to) && distance(from, to) <= 7; to = Square(to + dir))
-                {
-                    int fileDiff = abs(int(file_of(to)) - int(file_of(from)));
-                    int rankDiff = abs(int(rank_of(to)) - int(rank_of(from)));
-
-                    bool validQueenMove = (fileDiff == 0 || rankDiff == 0 || fileDiff == rankDiff);
-                    if (!validQueenMove)
-                        break;
-
-                    Piece captured = pos.piece_on(to);
-                    if (captured != NO_PIECE)
-                    {
-                        if (color_of(captured) != us)
-                        {
-                            cur->move = make_move(from, to);
-                            cur->value = VALUE_ZERO;
-                            ++cur;
-                        }
-                        break;
-                    }
-
-                    cur->move = make_move(from, to);
-                    cur->value = VALUE_ZERO;
-                    ++cur;
-                }
+                cur->move = make_move(from, pop_lsb(targets));
+                cur->value = VALUE_ZERO;
+                ++cur;
             }
         }
         else if (pt == KING)
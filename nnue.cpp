@@ -0,0 +1,367 @@
+#include "nnue.h"
+#include "board.h"
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#if defined(ZORN_NO_SIMD)
+#elif defined(__AVX2__)
+#define NNUE_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NNUE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace NNUE
+{
+    namespace
+    {
+        alignas(64) int16_t ftBiases[HalfDimensions];
+        alignas(64) int16_t ftWeights[Inputs * HalfDimensions];
+        alignas(64) int32_t l1Biases[L1Size];
+        alignas(64) int8_t l1Weights[L1Size * HalfDimensions * 2];
+        alignas(64) int32_t l2Biases[L2Size];
+        alignas(64) int8_t l2Weights[L2Size * L1Size];
+        alignas(64) int8_t outWeights[L2Size];
+        int32_t outBias;
+
+        bool isLoaded = false;
+
+        // Longest chain of states walked back to find a computed accumulator
+        // before a full refresh is cheaper.
+        const int MaxUpdateChain = 16;
+
+        struct FileHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t inputs;
+            uint32_t halfDimensions;
+            uint32_t l1Size;
+            uint32_t l2Size;
+        };
+
+        const uint32_t FileVersion = 1;
+
+        int feature_index(Color perspective, Piece pc, Square s)
+        {
+            if (perspective == BLACK)
+                s = Square(s ^ 56);
+
+            return ((type_of(pc) - 1) + 6 * (color_of(pc) != perspective)) * 64 + s;
+        }
+
+        template<bool Add>
+        void apply_feature(int16_t* acc, int index)
+        {
+            const int16_t* w = ftWeights + index * HalfDimensions;
+
+#if defined(NNUE_AVX2)
+            for (int i = 0; i < HalfDimensions; i += 16)
+            {
+                __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+                __m256i b = _mm256_loadu_si256((const __m256i*)(w + i));
+                _mm256_storeu_si256((__m256i*)(acc + i), Add ? _mm256_add_epi16(a, b) : _mm256_sub_epi16(a, b));
+            }
+#elif defined(NNUE_SSE2)
+            for (int i = 0; i < HalfDimensions; i += 8)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*)(acc + i));
+                __m128i b = _mm_loadu_si128((const __m128i*)(w + i));
+                _mm_storeu_si128((__m128i*)(acc + i), Add ? _mm_add_epi16(a, b) : _mm_sub_epi16(a, b));
+            }
+#else
+            for (int i = 0; i < HalfDimensions; ++i)
+                acc[i] = int16_t(Add ? acc[i] + w[i] : acc[i] - w[i]);
+#endif
+        }
+
+        // Clips the accumulator to [0, 127] and narrows it to bytes.
+        void transform(const int16_t* acc, uint8_t* out)
+        {
+#if defined(NNUE_AVX2)
+            const __m256i max = _mm256_set1_epi16(127);
+            for (int i = 0; i < HalfDimensions; i += 32)
+            {
+                __m256i a = _mm256_min_epi16(_mm256_loadu_si256((const __m256i*)(acc + i)), max);
+                __m256i b = _mm256_min_epi16(_mm256_loadu_si256((const __m256i*)(acc + i + 16)), max);
+                __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+                _mm256_storeu_si256((__m256i*)(out + i), packed);
+            }
+#elif defined(NNUE_SSE2)
+            const __m128i max = _mm_set1_epi16(127);
+            for (int i = 0; i < HalfDimensions; i += 16)
+            {
+                __m128i a = _mm_min_epi16(_mm_loadu_si128((const __m128i*)(acc + i)), max);
+                __m128i b = _mm_min_epi16(_mm_loadu_si128((const __m128i*)(acc + i + 8)), max);
+                _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(a, b));
+            }
+#else
+            for (int i = 0; i < HalfDimensions; ++i)
+                out[i] = uint8_t(std::min(std::max(int(acc[i]), 0), 127));
+#endif
+        }
+
+        // out = biases + weights * in, weights stored row by row.
+        template<int InDims, int OutDims>
+        void affine(const uint8_t* in, const int8_t* weights, const int32_t* biases, int32_t* out)
+        {
+#if defined(NNUE_AVX2)
+            static_assert(InDims % 32 == 0, "Input size must be a multiple of 32");
+            const __m256i ones = _mm256_set1_epi16(1);
+
+            for (int o = 0; o < OutDims; ++o)
+            {
+                const int8_t* row = weights + o * InDims;
+                __m256i sum = _mm256_setzero_si256();
+
+                for (int j = 0; j < InDims; j += 32)
+                {
+                    __m256i x = _mm256_loadu_si256((const __m256i*)(in + j));
+                    __m256i w = _mm256_loadu_si256((const __m256i*)(row + j));
+                    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+                }
+
+                __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+                s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+                s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+                out[o] = biases[o] + _mm_cvtsi128_si32(s);
+            }
+#elif defined(NNUE_SSE2)
+            static_assert(InDims % 16 == 0, "Input size must be a multiple of 16");
+            const __m128i zero = _mm_setzero_si128();
+
+            for (int o = 0; o < OutDims; ++o)
+            {
+                const int8_t* row = weights + o * InDims;
+                __m128i sum = _mm_setzero_si128();
+
+                for (int j = 0; j < InDims; j += 16)
+                {
+                    __m128i x = _mm_loadu_si128((const __m128i*)(in + j));
+                    __m128i w = _mm_loadu_si128((const __m128i*)(row + j));
+                    __m128i sign = _mm_cmpgt_epi8(zero, w);
+
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(w, sign)));
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(w, sign)));
+                }
+
+                sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+                sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+                out[o] = biases[o] + _mm_cvtsi128_si32(sum);
+            }
+#else
+            for (int o = 0; o < OutDims; ++o)
+            {
+                const int8_t* row = weights + o * InDims;
+                int32_t sum = biases[o];
+
+                for (int j = 0; j < InDims; ++j)
+                    sum += row[j] * in[j];
+
+                out[o] = sum;
+            }
+#endif
+        }
+
+        template<int Dims>
+        void clipped_relu(const int32_t* in, uint8_t* out)
+        {
+            for (int i = 0; i < Dims; ++i)
+                out[i] = uint8_t(std::min(std::max(in[i] >> WeightShift, 0), 127));
+        }
+
+        template<typename T>
+        bool read_array(const char*& p, const char* end, T* dst, size_t count)
+        {
+            if (size_t(end - p) < count * sizeof(T))
+                return false;
+
+            std::memcpy(dst, p, count * sizeof(T));
+            p += count * sizeof(T);
+            return true;
+        }
+    }
+
+    const char* simd_name()
+    {
+#if defined(NNUE_AVX2)
+        return "avx2";
+#elif defined(NNUE_SSE2)
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    bool loaded()
+    {
+        return isLoaded;
+    }
+
+    // The file is read whole and checked before any weight is replaced, so a
+    // bad file leaves the current network untouched.
+    bool load(const std::string& fileName)
+    {
+        std::ifstream in(fileName, std::ios::binary);
+        if (!in)
+            return false;
+
+        std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        const size_t expected = sizeof(FileHeader)
+            + sizeof(ftBiases) + sizeof(ftWeights)
+            + sizeof(l1Biases) + sizeof(l1Weights)
+            + sizeof(l2Biases) + sizeof(l2Weights)
+            + sizeof(outBias) + sizeof(outWeights);
+
+        if (data.size() != expected)
+            return false;
+
+        FileHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, "ZNUE", 4) != 0
+            || header.version != FileVersion
+            || header.inputs != Inputs
+            || header.halfDimensions != HalfDimensions
+            || header.l1Size != L1Size
+            || header.l2Size != L2Size)
+            return false;
+
+        const char* p = data.data() + sizeof(header);
+        const char* end = data.data() + data.size();
+
+        isLoaded = read_array(p, end, ftBiases, HalfDimensions)
+            && read_array(p, end, ftWeights, size_t(Inputs) * HalfDimensions)
+            && read_array(p, end, l1Biases, L1Size)
+            && read_array(p, end, l1Weights, size_t(L1Size) * HalfDimensions * 2)
+            && read_array(p, end, l2Biases, L2Size)
+            && read_array(p, end, l2Weights, size_t(L2Size) * L1Size)
+            && read_array(p, end, &outBias, 1)
+            && read_array(p, end, outWeights, L2Size);
+
+        return isLoaded;
+    }
+
+    // Fills the network with small random weights. Only meant for timing the
+    // kernels when no trained network is available; does not mark it loaded.
+    void init_random(uint64_t seed)
+    {
+        auto next = [&seed]() {
+            seed ^= seed >> 12;
+            seed ^= seed << 25;
+            seed ^= seed >> 27;
+            return int((seed * 2685821657736338717ULL) >> 40);
+        };
+
+        for (auto& b : ftBiases) b = int16_t(next() % 32);
+        for (auto& w : ftWeights) w = int16_t(next() % 17 - 8);
+        for (auto& b : l1Biases) b = next() % 256 - 128;
+        for (auto& w : l1Weights) w = int8_t(next() % 17 - 8);
+        for (auto& b : l2Biases) b = next() % 256 - 128;
+        for (auto& w : l2Weights) w = int8_t(next() % 33 - 16);
+        for (auto& w : outWeights) w = int8_t(next() % 65 - 32);
+        outBias = 0;
+    }
+
+    void refresh_accumulator(const Position& pos)
+    {
+        Accumulator& acc = pos.state()->accumulator;
+
+        for (Color perspective = WHITE; perspective <= BLACK; ++perspective)
+        {
+            std::memcpy(acc.values[perspective], ftBiases, sizeof(ftBiases));
+
+            for (Bitboard b = pos.pieces(); b; )
+            {
+                Square s = pop_lsb(b);
+                apply_feature<true>(acc.values[perspective], feature_index(perspective, pos.piece_on(s), s));
+            }
+        }
+
+        acc.computed = true;
+    }
+
+    // Brings the accumulator of the current state up to date by replaying the
+    // dirty pieces of each state since the last computed one.
+    void update_accumulator(const Position& pos)
+    {
+        StateInfo* st = pos.state();
+
+        if (st->accumulator.computed)
+            return;
+
+        StateInfo* path[MaxUpdateChain];
+        int n = 0;
+
+        for (StateInfo* s = st; !s->accumulator.computed; s = s->previous)
+        {
+            if (!s->previous || n == MaxUpdateChain)
+            {
+                refresh_accumulator(pos);
+                return;
+            }
+
+            path[n++] = s;
+        }
+
+        for (int i = n - 1; i >= 0; --i)
+        {
+            StateInfo* s = path[i];
+            const DirtyPiece& dp = s->dirtyPiece;
+
+            for (Color perspective = WHITE; perspective <= BLACK; ++perspective)
+            {
+                int16_t* acc = s->accumulator.values[perspective];
+                std::memcpy(acc, s->previous->accumulator.values[perspective], sizeof(s->accumulator.values[perspective]));
+
+                for (int k = 0; k < dp.count; ++k)
+                {
+                    if (dp.from[k] != SQ_NONE)
+                        apply_feature<false>(acc, feature_index(perspective, dp.piece[k], dp.from[k]));
+                    if (dp.to[k] != SQ_NONE)
+                        apply_feature<true>(acc, feature_index(perspective, dp.piece[k], dp.to[k]));
+                }
+            }
+
+            s->accumulator.computed = true;
+        }
+    }
+
+    Value propagate(const Position& pos)
+    {
+        const Accumulator& acc = pos.state()->accumulator;
+        const Color us = pos.side_to_move();
+
+        alignas(32) uint8_t input[HalfDimensions * 2];
+        alignas(32) int32_t l1Sums[L1Size];
+        alignas(32) uint8_t l1Out[L1Size];
+        alignas(32) int32_t l2Sums[L2Size];
+        alignas(32) uint8_t l2Out[L2Size];
+
+        transform(acc.values[us], input);
+        transform(acc.values[~us], input + HalfDimensions);
+
+        affine<HalfDimensions * 2, L1Size>(input, l1Weights, l1Biases, l1Sums);
+        clipped_relu<L1Size>(l1Sums, l1Out);
+
+        affine<L1Size, L2Size>(l1Out, l2Weights, l2Biases, l2Sums);
+        clipped_relu<L2Size>(l2Sums, l2Out);
+
+        int32_t out = outBias;
+        for (int i = 0; i < L2Size; ++i)
+            out += outWeights[i] * l2Out[i];
+
+        const int limit = VALUE_MATE_IN_MAX_PLY - 1;
+        return Value(std::min(std::max(out / OutputScale, -limit), limit));
+    }
+
+    Value evaluate(const Position& pos)
+    {
+        update_accumulator(pos);
+        return propagate(pos);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "types.h"
+#include <string>
+
+class Position;
+
+// Efficiently updatable neural network evaluation.
+//
+// Inputs are 768 piece-square features seen from each side (own pieces
+// first, board flipped for Black). The feature transformer keeps one int16
+// accumulator per perspective in StateInfo; do_move records which pieces
+// changed and the accumulator is brought up to date from the previous
+// state's one on demand. The two accumulators, side to move first, are
+// clipped to [0, 127] and fed through two int8 layers with clipped ReLU and
+// a linear output:
+//
+//     768 x 2 -> 256 x 2 -> 32 -> 32 -> 1
+namespace NNUE
+{
+    constexpr int Inputs = 768;
+    constexpr int HalfDimensions = 256;
+    constexpr int L1Size = 32;
+    constexpr int L2Size = 32;
+
+    // Hidden layer sums are shifted right by this before clipping, and the
+    // output is divided by OutputScale to give centipawns.
+    constexpr int WeightShift = 6;
+    constexpr int OutputScale = 16;
+
+    struct Accumulator
+    {
+        alignas(32) int16_t values[COLOR_NB][HalfDimensions];
+        bool computed;
+    };
+
+    // Pieces added, removed or moved by the last move: from is SQ_NONE for a
+    // piece put on the board and to is SQ_NONE for a piece taken off.
+    struct DirtyPiece
+    {
+        int count;
+        Piece piece[3];
+        Square from[3];
+        Square to[3];
+    };
+
+    bool load(const std::string& fileName);
+    void init_random(uint64_t seed);
+    bool loaded();
+    const char* simd_name();
+
+    // Side to move's point of view, like Eval::evaluate.
+    Value evaluate(const Position& pos);
+
+    void update_accumulator(const Position& pos);
+    void refresh_accumulator(const Position& pos);
+    Value propagate(const Position& pos);
+}
+
+#endif
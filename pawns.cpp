@@ -0,0 +1,167 @@
+#include "pawns.h"
+#include "board.h"
+#include "search.h"
+
+namespace Pawns
+{
+    const Value IsolatedMG = 5, IsolatedEG = 15;
+    const Value DoubledMG = 10, DoubledEG = 25;
+    const Value BackwardMG = 9, BackwardEG = 24;
+
+    const Value PassedMG[RANK_NB] = { 0, 0, 5, 10, 20, 40, 70, 0 };
+    const Value PassedEG[RANK_NB] = { 0, 10, 15, 25, 45, 80, 120, 0 };
+
+    template<Color Us>
+    void evaluate(Bitboard ourPawns, Bitboard theirPawns, Entry* e)
+    {
+        const Color Them = Us == WHITE ? BLACK : WHITE;
+        const int Up = Us == WHITE ? 8 : -8;
+
+        Value mg = 0, eg = 0;
+
+        e->passedPawns[Us] = e->pawnAttacksSpan[Us] = 0;
+        e->pawnAttacks[Us] = pawn_attacks_bb<Us>(ourPawns);
+        e->kingSquares[Us] = SQ_NONE;
+        e->kingShield[Us] = 0;
+
+        const Bitboard theirAttacks = pawn_attacks_bb<Them>(theirPawns);
+
+        for (Bitboard b = ourPawns; b; )
+        {
+            Square s = pop_lsb(b);
+            File f = file_of(s);
+
+            e->pawnAttacksSpan[Us] |= pawn_attack_span(Us, s);
+
+            bool isolated = !(ourPawns & adjacent_files_bb(f));
+            bool doubled = ourPawns & forward_file_bb(Us, s);
+
+            // No friendly pawn level with or behind it on an adjacent file,
+            // and the square in front is controlled by an enemy pawn.
+            bool backward = !isolated
+                && !(ourPawns & pawn_attack_span(Them, Square(s + Up)))
+                && (theirAttacks & square_bb(Square(s + Up)));
+
+            if (isolated)
+                mg -= IsolatedMG, eg -= IsolatedEG;
+            else if (backward)
+                mg -= BackwardMG, eg -= BackwardEG;
+
+            if (doubled)
+                mg -= DoubledMG, eg -= DoubledEG;
+            else if (!(theirPawns & passed_pawn_span(Us, s)))
+            {
+                e->passedPawns[Us] |= square_bb(s);
+                mg += PassedMG[relative_rank(Us, s)];
+                eg += PassedEG[relative_rank(Us, s)];
+            }
+        }
+
+        e->scores += Us == WHITE ? make_score(mg, eg) : -make_score(mg, eg);
+    }
+
+    template<Color Us>
+    Value king_shield(Bitboard ourPawns, Square ksq)
+    {
+        if (relative_rank(Us, ksq) != RANK_1)
+            return 0;
+
+        Bitboard shield = ourPawns & (adjacent_files_bb(file_of(ksq)) | file_bb(ksq));
+
+        return Value(10 * popcount(shield & rank_bb(relative_rank(Us, RANK_2)))
+            + 5 * popcount(shield & rank_bb(relative_rank(Us, RANK_3))));
+    }
+
+    template Value king_shield<WHITE>(Bitboard ourPawns, Square ksq);
+    template Value king_shield<BLACK>(Bitboard ourPawns, Square ksq);
+
+    template<Color Us>
+    Value Entry::do_king_shield(const Position& pos, Square ksq)
+    {
+        kingSquares[Us] = ksq;
+        return kingShield[Us] = Pawns::king_shield<Us>(pos.pieces(Us, PAWN), ksq);
+    }
+
+    template Value Entry::do_king_shield<WHITE>(const Position& pos, Square ksq);
+    template Value Entry::do_king_shield<BLACK>(const Position& pos, Square ksq);
+
+    void evaluate(Entry* e, Bitboard whitePawns, Bitboard blackPawns)
+    {
+        e->scores = SCORE_ZERO;
+        evaluate<WHITE>(whitePawns, blackPawns, e);
+        evaluate<BLACK>(blackPawns, whitePawns, e);
+    }
+
+    namespace
+    {
+        Bitboard north_fill(Bitboard b) { b |= b << 8; b |= b << 16; return b | b << 32; }
+        Bitboard south_fill(Bitboard b) { b |= b >> 8; b |= b >> 16; return b | b >> 32; }
+        Bitboard sideways(Bitboard b) { return ((b << 1) & ~file_bb(FILE_A)) | ((b >> 1) & ~file_bb(FILE_H)); }
+    }
+
+    // Same classification as evaluate<Us>: a pawn is isolated, else maybe
+    // backward; doubled, else maybe passed.
+    Structure structure(Bitboard whitePawns, Bitboard blackPawns)
+    {
+        Structure st;
+        const Bitboard pawns[COLOR_NB] = { whitePawns, blackPawns };
+
+        for (Color us = WHITE; us <= BLACK; ++us)
+        {
+            Bitboard ours = pawns[us], theirs = pawns[~us];
+
+            // Squares with a pawn ahead on the same file, with a pawn on an
+            // adjacent file level or behind, and whose stop square an enemy
+            // pawn attacks.
+            Bitboard ahead = us == WHITE ? south_fill(ours >> 8) : north_fill(ours << 8);
+            Bitboard theirAhead = us == WHITE ? south_fill(theirs >> 8) : north_fill(theirs << 8);
+            Bitboard supported = sideways(us == WHITE ? north_fill(ours) : south_fill(ours));
+            Bitboard stopAttacked = us == WHITE ? pawn_attacks_bb<BLACK>(theirs) >> 8 : pawn_attacks_bb<WHITE>(theirs) << 8;
+
+            st.isolated[us] = ours & ~sideways(north_fill(south_fill(ours)));
+            st.backward[us] = ours & ~st.isolated[us] & ~supported & stopAttacked;
+            st.doubled[us] = ours & ahead;
+            st.passed[us] = ours & ~st.doubled[us] & ~(theirAhead | sideways(theirAhead));
+        }
+
+        return st;
+    }
+
+    Score score(const Structure& st)
+    {
+        Score s = SCORE_ZERO;
+
+        for (Color us = WHITE; us <= BLACK; ++us)
+        {
+            Value mg = -IsolatedMG * popcount(st.isolated[us]) - BackwardMG * popcount(st.backward[us])
+                - DoubledMG * popcount(st.doubled[us]);
+            Value eg = -IsolatedEG * popcount(st.isolated[us]) - BackwardEG * popcount(st.backward[us])
+                - DoubledEG * popcount(st.doubled[us]);
+
+            for (Bitboard b = st.passed[us]; b; )
+            {
+                Rank r = relative_rank(us, pop_lsb(b));
+                mg += PassedMG[r];
+                eg += PassedEG[r];
+            }
+
+            s += us == WHITE ? make_score(mg, eg) : -make_score(mg, eg);
+        }
+
+        return s;
+    }
+
+    Entry* probe(const Position& pos)
+    {
+        Key key = pos.pawn_key();
+        Entry* e = pos.this_thread()->pawnsTable[key];
+
+        if (e->key == key)
+            return e;
+
+        e->key = key;
+        evaluate(e, pos.pieces(WHITE, PAWN), pos.pieces(BLACK, PAWN));
+
+        return e;
+    }
+}
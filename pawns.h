@@ -0,0 +1,67 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include "types.h"
+#include "bitboard.h"
+
+class Position;
+
+namespace Pawns
+{
+    // Everything that depends only on the pawns of both sides. Scores are
+    // from White's point of view; the king shield is computed on demand and
+    // remembered for the last king square seen.
+    struct Entry
+    {
+        Score score() const { return scores; }
+        Bitboard passed_pawns(Color c) const { return passedPawns[c]; }
+        Bitboard pawn_attacks(Color c) const { return pawnAttacks[c]; }
+        Bitboard pawn_attacks_span(Color c) const { return pawnAttacksSpan[c]; }
+
+        template<Color Us>
+        Value king_shield(const Position& pos, Square ksq)
+        {
+            return kingSquares[Us] == ksq ? kingShield[Us] : do_king_shield<Us>(pos, ksq);
+        }
+
+        template<Color Us>
+        Value do_king_shield(const Position& pos, Square ksq);
+
+        Key key;
+        Bitboard passedPawns[COLOR_NB];
+        Bitboard pawnAttacks[COLOR_NB];
+        Bitboard pawnAttacksSpan[COLOR_NB];
+        Square kingSquares[COLOR_NB];
+        Value kingShield[COLOR_NB];
+        Score scores;
+    };
+
+    typedef HashTable<Entry, 16384> Table;
+
+    Entry* probe(const Position& pos);
+
+    // Fills e from the pawn bitboards alone, for callers without a Position.
+    // The key and the king shield cache are left alone.
+    void evaluate(Entry* e, Bitboard whitePawns, Bitboard blackPawns);
+
+    // Each side's pawns grouped by the terms that score them. Entry
+    // evaluation classifies pawns one at a time; structure() finds the same
+    // sets with whole-board shifts and fills, which also vectorise.
+    struct Structure
+    {
+        Bitboard isolated[COLOR_NB];
+        Bitboard backward[COLOR_NB];
+        Bitboard doubled[COLOR_NB];
+        Bitboard passed[COLOR_NB];
+    };
+
+    Structure structure(Bitboard whitePawns, Bitboard blackPawns);
+
+    // Equal to Entry::score() for the pawns the structure was found from.
+    Score score(const Structure& st);
+
+    template<Color Us>
+    Value king_shield(Bitboard ourPawns, Square ksq);
+}
+
+#endif
@@ -5,32 +5,116 @@
 #include "uci.h"
 #include "eval.h"
 #include "tt.h"
+#include "syzygy.h"
+#include "egtb.h"
+#include "cluster.h"
+#include "timeman.h"
+#include "nnue.h"
 #include <iostream>
 #include <algorithm>
 #include <vector>
 #include <chrono>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std;
 using namespace std::chrono;
 
 Thread* Threads = nullptr;
+std::vector<Thread*> ThreadPool;
+
+// Over-aligned new is only guaranteed from C++17, so the block is aligned by
+// hand and the pointer malloc returned is kept just below the object.
+void* Thread::operator new(size_t size)
+{
+    void* mem = std::malloc(size + alignof(Thread) + sizeof(void*));
+    if (!mem)
+        throw std::bad_alloc();
+
+    void* ret = reinterpret_cast<void*>((uintptr_t(mem) + sizeof(void*) + alignof(Thread) - 1) & ~uintptr_t(alignof(Thread) - 1));
+    static_cast<void**>(ret)[-1] = mem;
+    return ret;
+}
+
+void Thread::operator delete(void* p)
+{
+    if (p)
+        std::free(static_cast<void**>(p)[-1]);
+}
 
 namespace Search
 {
+    int StopLatency = 5;
+
+    // Node and tbhit counters are written by their own thread only, so a
+    // relaxed load and store do, without a locked read-modify-write
+    static inline void add(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
     void init()
     {
         Threads = new Thread(0);
+        Threads->evalCache.resize(4);
+        ThreadPool.push_back(Threads);
         TT.resize(64);
         initTables();
     }
+
+    // The main thread is kept, so its caches and history survive
+    void set_threads(size_t n)
+    {
+        n = std::max(n, size_t(1));
+
+        while (ThreadPool.size() > n)
+        {
+            delete ThreadPool.back();
+            ThreadPool.pop_back();
+        }
+
+        while (ThreadPool.size() < n)
+            ThreadPool.push_back(new Thread(ThreadPool.size()));
+    }
+
+    uint64_t nodes_searched()
+    {
+        uint64_t nodes = 0;
+        for (const Thread* th : ThreadPool)
+            nodes += th->nodes.load(std::memory_order_relaxed);
+        return nodes;
+    }
+
+    uint64_t tb_hits()
+    {
+        uint64_t hits = 0;
+        for (const Thread* th : ThreadPool)
+            hits += th->tbHits.load(std::memory_order_relaxed);
+        return hits;
+    }
+
+    double stop_latency()
+    {
+        return getSearchInfo().stopLatency;
+    }
+
     static Value quiesce(Position& pos, Value alpha, Value beta, int ply)
     {
+        Thread* th = pos.this_thread();
+
         if (ply >= 100) return Eval::evaluate(pos);
-        if (timeUp()) return VALUE_ZERO;
+        if (timeUp(th)) return VALUE_ZERO;
 
-        ++getSearchInfo().nodeCount;
+        add(th->nodes, 1);
 
-        Value standPat = Eval::evaluate(pos);
+        // Only which side of [alpha - 200, beta) stand pat falls on matters
+        // below, so a lazy evaluation outside that range is as good.
+        bool lazy;
+        Value standPat = Eval::evaluate(pos, Value(alpha - 201), beta, lazy);
         if (standPat >= beta) return beta;
         if (standPat > alpha) alpha = standPat;
 
@@ -65,34 +149,102 @@ namespace Search
 
     static Value search(Position& pos, Value alpha, Value beta, Depth depth, int ply, bool cutNode)
     {
-        if (timeUp()) return VALUE_ZERO;
+        Thread* th = pos.this_thread();
+
+        if (timeUp(th)) return VALUE_ZERO;
         if (depth <= 0) return quiesce(pos, alpha, beta, ply);
         if (ply >= 100) return Eval::evaluate(pos);
 
-        ++getSearchInfo().nodeCount;
-
-        if (getSearchInfo().nodeCount % 200000 == 0)
-        {
-            auto elapsed = duration_cast<milliseconds>(steady_clock::now() - getSearchInfo().startTime).count();
-            if (elapsed > 60000) return Eval::evaluate(pos);
-        }
+        add(th->nodes, 1);
 
         bool isPv = (beta - alpha) > 1;
         bool inCheck = pos.checkers() != 0;
 
         bool found;
-        TTEntry* tte = TT.probe(pos.key(), found);
+        TTEntry* tte = TT.probe(pos.key(), found, depth);
         Move ttMove = found ? tte->move() : MOVE_NONE;
+        Value ttValue = found ? valueFromTT(tte->value(), ply) : VALUE_NONE;
 
-        if (found && tte->depth() >= depth && !isPv)
+        if (found && tte->depth() >= depth && !isPv && ttValue != VALUE_NONE)
         {
-            Value ttValue = tte->value();
             if (tte->bound() == BOUND_EXACT) return ttValue;
             if (tte->bound() == BOUND_LOWER && ttValue >= beta) return ttValue;
             if (tte->bound() == BOUND_UPPER && ttValue <= alpha) return ttValue;
         }
 
-        Value staticEval = inCheck ? VALUE_NONE : Eval::evaluate(pos);
+        // Own DTM tables give the exact distance to mate
+        Value egtbValue;
+        if (ply > 0 && EGTB::probe(pos, ply, egtbValue))
+        {
+            add(th->tbHits, 1);
+            tte->save(pos.key(), valueToTT(egtbValue, ply), isPv, BOUND_EXACT,
+                std::min(MAX_PLY - 1, depth + 6), MOVE_NONE, VALUE_NONE);
+            return egtbValue;
+        }
+
+        // Tablebase probe. The WDL tables know nothing of earlier moves, so
+        // they are only trusted right after a capture or pawn move.
+        int tbCardinality = getSearchInfo().tbCardinality;
+        if (ply > 0 && tbCardinality && pos.rule50_count() == 0 && !pos.can_castle(ANY_CASTLING))
+        {
+            int pieceCount = popcount(pos.pieces());
+
+            if (pieceCount < tbCardinality || (pieceCount == tbCardinality && depth >= Tablebases::ProbeDepth))
+            {
+                Tablebases::ProbeState result;
+                Tablebases::WDLScore wdl = Tablebases::probe_wdl(pos, &result);
+
+                if (result != Tablebases::FAIL)
+                {
+                    add(th->tbHits, 1);
+
+                    // Cursed wins and blessed losses score just off a draw
+                    Value value = wdl < Tablebases::WDLBlessedLoss ? VALUE_MATED_IN_MAX_PLY + ply + 1
+                        : wdl > Tablebases::WDLCursedWin ? VALUE_MATE_IN_MAX_PLY - ply - 1
+                        : Value(VALUE_DRAW + 2 * wdl);
+
+                    Bound bound = wdl < Tablebases::WDLBlessedLoss ? BOUND_UPPER
+                        : wdl > Tablebases::WDLCursedWin ? BOUND_LOWER : BOUND_EXACT;
+
+                    if (bound == BOUND_EXACT || (bound == BOUND_LOWER ? value >= beta : value <= alpha))
+                    {
+                        tte->save(pos.key(), valueToTT(value, ply), isPv, bound,
+                            std::min(MAX_PLY - 1, depth + 6), MOVE_NONE, VALUE_NONE);
+                        return value;
+                    }
+                }
+            }
+        }
+
+        Value rawEval = VALUE_NONE, staticEval = VALUE_NONE;
+        bool lazyEval = false;
+
+        if (!inCheck)
+        {
+            if (found && tte->eval() != VALUE_NONE)
+                rawEval = tte->eval();
+            else if (!isPv && depth <= 6)
+            {
+                // Frontier nodes use the eval only for the futility tests
+                // below, so it may stop early once one of them is decided.
+                Value lo = Value(std::max(alpha - 150 - 200 * depth, -VALUE_INFINITE + 0));
+                Value hi = depth <= 3 ? Value(std::min(beta + 200 * depth, VALUE_INFINITE + 0)) : VALUE_INFINITE;
+                rawEval = Eval::evaluate(pos, lo, hi, lazyEval);
+            }
+            else
+                rawEval = Eval::evaluate(pos);
+
+            if (!found)
+                tte->save(pos.key(), VALUE_NONE, isPv, BOUND_NONE, DEPTH_NONE, MOVE_NONE, lazyEval ? VALUE_NONE : rawEval);
+
+            staticEval = rawEval;
+
+            // A stored search score is a better estimate than the static eval
+            // whenever its bound points in the right direction.
+            if (ttValue != VALUE_NONE && abs(ttValue) < VALUE_MATE_IN_MAX_PLY
+                && (tte->bound() & (ttValue > staticEval ? BOUND_LOWER : BOUND_UPPER)))
+                staticEval = ttValue;
+        }
 
         if (!isPv && !inCheck && depth >= 3)
         {
@@ -103,7 +255,7 @@ namespace Search
             pos.undo_null_move();
 
             if (nullValue >= beta)
-                return nullValue >= VALUE_MATE - 100 ? beta : nullValue;
+                return nullValue >= VALUE_MATE_IN_MAX_PLY ? beta : nullValue;
         }
 
         if (!isPv && !inCheck && depth <= 3 && staticEval - 200 * depth >= beta)
@@ -118,9 +270,12 @@ namespace Search
         ScoredMove moves[256];
         int moveCount = 0;
 
+        const vector<Move>& rootMoves = getSearchInfo().rootMoves;
+
         for (const auto& move : MoveList(pos))
         {
-            if (pos.legal(move))
+            if (pos.legal(move)
+                && (ply > 0 || rootMoves.empty() || std::find(rootMoves.begin(), rootMoves.end(), move) != rootMoves.end()))
             {
                 moves[moveCount].move = move;
                 moves[moveCount].score = scoreMove(pos, move, ttMove, ply);
@@ -128,6 +283,12 @@ namespace Search
             }
         }
 
+        // A stored move that is not legal here means the entry belongs to
+        // another position with the same verification bits.
+        if (ttMove != MOVE_NONE && TT.stats_enabled()
+            && std::none_of(moves, moves + moveCount, [ttMove](const ScoredMove& sm) { return sm.move == ttMove; }))
+            TT.record_false_hit();
+
         if (moveCount == 0)
         {
             return inCheck ? -VALUE_MATE + ply : VALUE_DRAW;
@@ -164,7 +325,7 @@ namespace Search
             bool isCapture = pos.piece_on(to) != NO_PIECE || type_of(move) == ENPASSANT;
             bool isPromotion = type_of(move) == PROMOTION;
             bool isQuiet = !isCapture && !isPromotion;
-            bool isKiller = ply < 64 && (move == getKillerMove(ply, 0) || move == getKillerMove(ply, 1));
+            bool isKiller = ply < 64 && (move == getKillerMove(th, ply, 0) || move == getKillerMove(th, ply, 1));
             bool givesCheck = pos.gives_check(move);
 
             if (!isPv && !inCheck && isQuiet && movesSearched >= 8 && depth <= 6)
@@ -218,7 +379,7 @@ namespace Search
             pos.undo_move(move);
             movesSearched++;
 
-            if (timeUp()) return bestValue > -VALUE_INFINITE ? bestValue : VALUE_ZERO;
+            if (timeUp(th)) return bestValue > -VALUE_INFINITE ? bestValue : VALUE_ZERO;
 
             if (value > bestValue)
             {
@@ -233,8 +394,8 @@ namespace Search
                     {
                         if (isQuiet)
                         {
-                            updateKillers(move, ply);
-                            updateHistory(pos.side_to_move(), from, to, depth, true);
+                            updateKillers(th, move, ply);
+                            updateHistory(th, pos.side_to_move(), from, to, depth, true);
                         }
                         break;
                     }
@@ -242,7 +403,7 @@ namespace Search
             }
 
             if (isQuiet)
-                updateHistory(pos.side_to_move(), from, to, depth, false);
+                updateHistory(th, pos.side_to_move(), from, to, depth, false);
         }
 
         if (bestValue == -VALUE_INFINITE)
@@ -251,73 +412,397 @@ namespace Search
         Bound bound = bestValue >= beta ? BOUND_LOWER :
             bestValue > originalAlpha ? BOUND_EXACT : BOUND_UPPER;
 
-        tte->save(pos.key(), bestValue, isPv, bound, depth, bestMove, staticEval);
+        // A lazy eval only held for this node's window, so it is not kept
+        Value ttEval = lazyEval ? VALUE_NONE : rawEval;
+        tte->save(pos.key(), valueToTT(bestValue, ply), isPv, bound, depth, bestMove, ttEval);
+
+        if (Cluster::active && depth >= Cluster::ShareDepth)
+            Cluster::share(pos.key(), valueToTT(bestValue, ply), bound, depth, bestMove, ttEval);
+
+        // Read back by the iteration rather than from the shared TT, where
+        // another thread may already have replaced the root entry
+        if (ply == 0)
+            th->rootMove = bestMove;
 
         return bestValue;
     }
 
-    void start(Position& pos, const Limits& limits)
+    // Root moves are limited to searchmoves and, when the root is in the
+    // tablebases, to those that keep its result. With DTZ the choice is then
+    // already exact and probing in the tree is switched off.
+    static void setup_root(Position& pos, const Limits& limits)
     {
-        initSearch(limits, pos);
+        SearchInfo& si = getSearchInfo();
 
-        TT.new_search();
-        clearKillers();
+        si.rootMoves.clear();
+        for (const auto& move : MoveList(pos))
+            if (pos.legal(move) && (limits.searchmoves.empty()
+                || std::find(limits.searchmoves.begin(), limits.searchmoves.end(), move) != limits.searchmoves.end()))
+                si.rootMoves.push_back(move);
 
-        Value bestValue = -VALUE_INFINITE;
-        Move bestMove = MOVE_NONE;
+        si.tbCardinality = Tablebases::MaxCardinality;
 
-        int maxDepth = limits.depth > 0 ? std::min(limits.depth, 20) : 15;
+        if (popcount(pos.pieces()) > si.tbCardinality || pos.can_castle(ANY_CASTLING))
+            return;
 
-        for (Depth depth = 2; depth <= maxDepth; ++depth)
+        bool usedDTZ;
+        vector<Move> moves = si.rootMoves;
+
+        if (Tablebases::root_probe(pos, moves, usedDTZ))
         {
-            if (timeUp()) break;
+            add(Threads->tbHits, si.rootMoves.size());
+            si.rootMoves = moves;
+            if (usedDTZ)
+                si.tbCardinality = 0;
+        }
+    }
 
-            auto depthStart = steady_clock::now();
-            bestValue = search(pos, -VALUE_INFINITE, VALUE_INFINITE, depth, 0, false);
-            auto depthEnd = steady_clock::now();
+    // Helper threads skip some iterations, so that between them they cover
+    // the next few depths instead of all searching the one the main thread
+    // is on. Thread i takes row (i - 1) % 20: depths go in blocks of
+    // SkipSize, every other block skipped, shifted by SkipPhase.
+    static const int SkipSize[] = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+    static const int SkipPhase[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
 
-            if (timeUp()) break;
+    static void report(Depth depth, Value value, Move move, const Position& pos)
+    {
+        int elapsed = Time.elapsed();
+        uint64_t nodes = nodes_searched();
+
+        cout << "info depth " << int(depth)
+            << " score " << UCI::value(value)
+            << " nodes " << nodes
+            << " time " << elapsed
+            << " nps " << (elapsed > 0 ? (nodes * 1000) / elapsed : 0)
+            << " hashfull " << TT.hashfull()
+            << " tbhits " << tb_hits()
+            << " pv " << UCI::move(move, pos.is_chess960())
+            << endl;
+    }
 
-            bool found;
-            TTEntry* tte = TT.probe(pos.key(), found);
-            if (found && tte->move() != MOVE_NONE)
-                bestMove = tte->move();
+    // Searches the root in a window around the expected score. Scores here
+    // swing between odd and even depths, so the centre is the mean of the
+    // last two iterations, which tracks the next score more closely than
+    // the last one alone. A fail moves the failed bound past the returned
+    // score by a delta that grows by half each time; a fail low also pulls
+    // beta to the middle of the old window. A fail-high move is kept at
+    // once, in case the re-search is cut short; a fail-low move is not, as
+    // all moves were bounded from above.
+    static Value aspiration(Thread* th, Position& pos, Value center)
+    {
+        int delta = 100;
+        Value alpha = -VALUE_INFINITE, beta = VALUE_INFINITE;
 
-            auto elapsed = int(duration_cast<milliseconds>(steady_clock::now() - getSearchInfo().startTime).count());
-            auto depthTime = int(duration_cast<milliseconds>(depthEnd - depthStart).count());
-            Threads->nodes = getSearchInfo().nodeCount;
+        if (th->rootDepth >= 5 && center != VALUE_NONE && abs(center) < VALUE_MATE_IN_MAX_PLY)
+        {
+            alpha = Value(std::max(center - delta, -VALUE_INFINITE + 0));
+            beta = Value(std::min(center + delta, VALUE_INFINITE + 0));
+        }
 
-            cout << "info depth " << depth
-                << " score " << UCI::value(bestValue)
-                << " nodes " << getSearchInfo().nodeCount
-                << " time " << elapsed
-                << " nps " << (elapsed > 0 ? (getSearchInfo().nodeCount * 1000) / elapsed : 0)
-                << " pv " << UCI::move(bestMove, pos.is_chess960())
-                << endl;
+        ++th->aspirationStats.iterations;
 
-            if (abs(bestValue) >= VALUE_MATE - 100)
-                break;
+        while (true)
+        {
+            th->rootMove = MOVE_NONE;
+            Value value = search(pos, alpha, beta, th->rootDepth, 0, false);
+
+            if (timeUp(th) || (value > alpha && value < beta))
+                return value;
+
+            if (value <= alpha)
+            {
+                ++th->aspirationStats.failLows;
+                beta = Value((alpha + beta) / 2);
+                alpha = Value(std::max(value - delta, -VALUE_INFINITE + 0));
+            }
+            else
+            {
+                ++th->aspirationStats.failHighs;
+                if (th->rootMove != MOVE_NONE)
+                    th->bestMove = th->rootMove;
+                beta = Value(std::min(value + delta, VALUE_INFINITE + 0));
+            }
+
+            delta += delta / 2;
+        }
+    }
+
+    // Iterative deepening, run by every thread on its own position. All of
+    // them share the TT; only the main thread reports and decides when the
+    // search is over. On the clock the optimum time is stretched while the
+    // best move keeps changing or the score drops, and shrunk while both
+    // hold still; no new iteration starts once half of it is gone.
+    static void iterate(Thread* th, Position& pos, const Limits& limits, int maxDepth)
+    {
+        const SearchInfo& si = getSearchInfo();
+        bool mainThread = th == Threads;
+        double bestMoveChanges = 0;
+        Value previousValue = VALUE_NONE, earlierValue = VALUE_NONE;
+
+        for (th->rootDepth = 2; th->rootDepth <= maxDepth; ++th->rootDepth)
+        {
+            if (!mainThread)
+            {
+                int row = int((th->idx - 1) % 20);
+                if (((th->rootDepth + SkipPhase[row]) / SkipSize[row]) % 2)
+                    continue;
+            }
+
+            if (si.stopped) break;
+
+            Move previousMove = th->bestMove;
+            Value value = aspiration(th, pos, earlierValue == VALUE_NONE ? previousValue
+                : Value((earlierValue + previousValue) / 2));
+
+            if (timeUp(th)) break;
 
-            if (depth >= 8 && depthTime > getSearchInfo().timeLimit / 2)
+            th->completedDepth = th->rootDepth;
+            th->bestValue = value;
+            if (th->rootMove != MOVE_NONE)
+                th->bestMove = th->rootMove;
+
+            if (mainThread)
+                report(th->completedDepth, th->bestValue, th->bestMove, pos);
+
+            if (abs(value) >= VALUE_MATE_IN_MAX_PLY)
                 break;
+
+            bestMoveChanges = bestMoveChanges / 2 + (th->bestMove != previousMove);
+
+            if (mainThread && !si.ponder && limits.use_time_management() && Time.optimum())
+            {
+                double stability = std::min(2.0, 0.8 + 0.6 * bestMoveChanges);
+                double scoreDrop = previousValue == VALUE_NONE ? 1.0
+                    : std::max(0.75, std::min(1.5, 1.0 + (previousValue - value) / 200.0));
+                double budget = std::min(double(Time.maximum()), Time.optimum() * stability * scoreDrop);
+
+                if (Time.elapsed() * 2 > budget)
+                    break;
+            }
+
+            earlierValue = previousValue;
+            previousValue = value;
+        }
+    }
+
+    // Each thread and each cluster worker votes for its best move, weighted
+    // by the depth it completed and by how far its score is above the
+    // lowest one. The main thread's move wins ties.
+    static Cluster::Result vote(const vector<Cluster::Result>& remote)
+    {
+        const vector<Move>& rootMoves = getSearchInfo().rootMoves;
+        vector<Cluster::Result> ballots;
+
+        for (const Thread* th : ThreadPool)
+            ballots.push_back({ th->bestMove, th->bestValue, th->completedDepth, th->nodes.load(std::memory_order_relaxed) });
+
+        for (const Cluster::Result& r : remote)
+            if (std::find(rootMoves.begin(), rootMoves.end(), r.move) != rootMoves.end())
+                ballots.push_back(r);
+
+        Cluster::Result best = ballots[0];
+        Value minScore = best.value;
+        std::map<Move, int64_t> votes;
+
+        for (const Cluster::Result& b : ballots)
+            if (b.move != MOVE_NONE)
+                minScore = std::min(minScore, b.value);
+
+        for (const Cluster::Result& b : ballots)
+            if (b.move != MOVE_NONE)
+                votes[b.move] += int64_t(b.value - minScore + 14) * b.depth;
+
+        for (const Cluster::Result& b : ballots)
+            if (b.move != MOVE_NONE && votes[b.move] > votes[best.move])
+                best = b;
+
+        return best;
+    }
+
+    static std::thread searchThread;
+
+    // Guards the flag changes the timer and think() sleep on
+    static std::mutex stopMutex;
+    static std::condition_variable stopSignal;
+
+    // Raises the stop flag for a stop command or the clock and notes when,
+    // for stop_latency(). Called with stopMutex held.
+    static void request_stop()
+    {
+        int64_t none = 0;
+        int64_t now = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        getSearchInfo().stopRequest.compare_exchange_strong(none, now);
+        getSearchInfo().ponder = false;
+        getSearchInfo().stopped = true;
+        stopSignal.notify_all();
+    }
+
+    // Sleeps until the maximum time, or until ponderhit while pondering,
+    // so the search itself never reads the clock
+    static void run_timer()
+    {
+        const SearchInfo& si = getSearchInfo();
+        std::unique_lock<std::mutex> lock(stopMutex);
+
+        while (!si.stopped)
+        {
+            int remaining = Time.maximum() - Time.elapsed();
+
+            if (si.ponder)
+                stopSignal.wait(lock);
+            else if (remaining > 0)
+                stopSignal.wait_for(lock, milliseconds(remaining));
+            else
+                request_stop();
+        }
+    }
+
+    static void think(Position& pos, const Limits& limits)
+    {
+        initSearch(limits, pos);
+
+        TT.new_search();
+
+        for (Thread* th : ThreadPool)
+        {
+            th->nodes.store(0, std::memory_order_relaxed);
+            th->tbHits.store(0, std::memory_order_relaxed);
+            th->nextPoll = 0;
+            th->stopping = false;
+            th->completedDepth = 0;
+            th->bestMove = MOVE_NONE;
+            th->bestValue = -VALUE_INFINITE;
+            clearKillers(th);
+        }
+
+        setup_root(pos, limits);
+        Cluster::start_search(pos, limits);
+
+        std::thread timer;
+        if (Time.maximum())
+            timer = std::thread(run_timer);
+
+        int maxDepth = limits.depth > 0 ? std::min(limits.depth, 20) : 63;
+
+        // Helpers get their own copy of the root. The state is copied after
+        // set() so the earlier game positions stay reachable for repetition
+        // checks. The root accumulator is computed first: NNUE updates then
+        // stop at each thread's own root state instead of all writing to
+        // the shared game states behind it.
+        const string fen = pos.fen();
+        const StateInfo* rootState = pos.state();
+        const bool chess960 = pos.is_chess960();
+        vector<std::thread> helpers;
+
+        if (Eval::useNNUE)
+            NNUE::update_accumulator(pos);
+
+        for (size_t i = 1; i < ThreadPool.size(); ++i)
+            helpers.emplace_back([&, i]() {
+                Thread* th = ThreadPool[i];
+                StateInfo st;
+                Position helperPos;
+                helperPos.set(fen, chess960, &st, th);
+                st = *rootState;
+                iterate(th, helperPos, limits, maxDepth);
+            });
+
+        iterate(Threads, pos, limits, maxDepth);
+
+        SearchInfo& si = getSearchInfo();
+        int searchTime = Time.elapsed();
+        uint64_t mainNodes = Threads->nodes.load(std::memory_order_relaxed);
+        if (searchTime >= 10 && mainNodes > 0)
+            si.nodesPerMs = double(mainNodes) / searchTime;
+
+        // When pondering or in infinite mode bestmove may only be sent
+        // after ponderhit or stop
+        {
+            std::unique_lock<std::mutex> lock(stopMutex);
+            stopSignal.wait(lock, [&]() { return si.stopped || !(si.ponder || limits.infinite); });
+            si.stopped = true;
+            stopSignal.notify_all();
+        }
+
+        if (timer.joinable())
+            timer.join();
+        for (std::thread& helper : helpers)
+            helper.join();
+
+        vector<Cluster::Result> remote = Cluster::stop_search();
+        Move bestMove = Threads->bestMove;
+
+        if ((ThreadPool.size() > 1 || !remote.empty()) && !limits.depth && bestMove != MOVE_NONE)
+        {
+            Cluster::Result best = vote(remote);
+            if (best.move != bestMove)
+                report(best.depth, best.value, best.move, pos);
+            bestMove = best.move;
         }
 
         if (bestMove != MOVE_NONE)
             cout << "bestmove " << UCI::move(bestMove, pos.is_chess960()) << endl;
         else
         {
-            for (const auto& move : MoveList(pos))
-            {
-                if (pos.legal(move))
+            if (!getSearchInfo().rootMoves.empty())
+                bestMove = getSearchInfo().rootMoves[0];
+            else
+                for (const auto& move : MoveList(pos))
                 {
-                    bestMove = move;
-                    break;
+                    if (pos.legal(move))
+                    {
+                        bestMove = move;
+                        break;
+                    }
                 }
-            }
             if (bestMove != MOVE_NONE)
                 cout << "bestmove " << UCI::move(bestMove, pos.is_chess960()) << endl;
             else
                 cout << "bestmove (none)" << endl;
         }
+
+        if (int64_t requested = si.stopRequest)
+            si.stopLatency = (duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() - requested) / 1e6;
+    }
+
+    void start(Position& pos, const Limits& limits)
+    {
+        getSearchInfo().stopped = false;
+        getSearchInfo().ponder = false;
+        getSearchInfo().stopRequest = 0;
+        think(pos, limits);
+    }
+
+    // The flags are set before the thread starts, so a stop that follows
+    // at once is not lost.
+    void go(Position& pos, const Limits& limits, bool ponder)
+    {
+        wait();
+
+        getSearchInfo().stopped = false;
+        getSearchInfo().ponder = ponder;
+        getSearchInfo().stopRequest = 0;
+        searchThread = std::thread(think, std::ref(pos), limits);
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        request_stop();
+    }
+
+    // The opponent played the expected move: from now on the search runs
+    // on the clock, which counts from go
+    void ponderhit()
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        getSearchInfo().ponder = false;
+        stopSignal.notify_all();
+    }
+
+    void wait()
+    {
+        if (searchThread.joinable())
+            searchThread.join();
     }
 }
\ No newline at end of file
@@ -3,20 +3,30 @@
 
 #include "types.h"
 #include "move.h"
+#include "pawns.h"
+#include "material.h"
+#include "eval.h"
 #include <vector>
 #include <chrono>
+#include <atomic>
 
 class Position;
 
 namespace Search
 {
+    // Limits and root data shared by all search threads. Counters that
+    // every node touches live in Thread instead.
     struct SearchInfo
     {
-        std::chrono::steady_clock::time_point startTime;
-        int timeLimit = 0;
-        bool stopped = false;
-        uint64_t nodeCount = 0;
-        uint64_t maxNodes = 20000000;
+        std::atomic<bool> stopped{ false };
+        std::atomic<bool> ponder{ false }; // Clock ignored until ponderhit
+        uint64_t maxNodes = 0; // go nodes, 0 for no limit
+        uint64_t pollInterval = 1024; // Nodes between looks at the flags
+        double nodesPerMs = 0; // Per thread, measured by the last search
+        std::atomic<int64_t> stopRequest{ 0 }; // When stopped was raised, ns
+        double stopLatency = -1; // Stop to bestmove of the last search, ms
+        int tbCardinality = 0;
+        std::vector<Move> rootMoves;
     };
 
     struct Limits
@@ -35,22 +45,67 @@ namespace Search
         int time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, movestogo, depth, nodes, mate, perft, infinite;
     };
 
+    // Bound in ms on the time from a stop, by command or clock, to bestmove
+    extern int StopLatency;
+
+    // Root searches per iteration: a re-search follows each fail
+    struct AspirationStats
+    {
+        uint64_t iterations = 0;
+        uint64_t failLows = 0;
+        uint64_t failHighs = 0;
+    };
+
     void init();
+    void set_threads(size_t n);
     void start(Position& pos, const Limits& limits);
+
+    // The same on a thread of its own, so the caller can keep reading
+    // commands. pos must stay unchanged until wait() returns.
+    void go(Position& pos, const Limits& limits, bool ponder);
+    void stop();
+    void ponderhit();
+    void wait();
+    uint64_t nodes_searched();
+    uint64_t tb_hits();
+    double stop_latency();
 }
 
-class Thread
+// One search thread and the state it does not share. Threads are allocated
+// on cache-line boundaries and padded to whole lines, so counters written at
+// every node never share a line with another thread's.
+class alignas(64) Thread
 {
 public:
-    Thread() : idx(0), nodes(0), rootDepth(0) {}
-    Thread(size_t n) : idx(n), nodes(0), rootDepth(0) {}
+    Thread() : Thread(0) {}
+    Thread(size_t n) : idx(n), nodes(0), tbHits(0), nextPoll(0), stopping(false), rootDepth(0), completedDepth(0),
+        rootMove(MOVE_NONE), bestMove(MOVE_NONE), bestValue(-VALUE_INFINITE), history(), killerMoves() {}
     virtual ~Thread() = default;
 
+    static void* operator new(size_t size);
+    static void operator delete(void* p);
+
     size_t idx;
-    uint64_t nodes;
+    std::atomic<uint64_t> nodes;  // Written by this thread only, read by
+    std::atomic<uint64_t> tbHits; // all: relaxed loads and stores suffice
+    uint64_t nextPoll; // timeUp looks at the shared flags at this node count
+    bool stopping;     // and caches what it saw here
     Depth rootDepth;
+    Depth completedDepth;
+    Move rootMove;   // Best move of the iteration in progress
+    Move bestMove;   // and of the last completed one
+    Value bestValue;
+    int history[COLOR_NB][SQUARE_NB][SQUARE_NB];
+    Move killerMoves[64][2];
+    Pawns::Table pawnsTable;
+    Material::Table materialTable;
+    Eval::Cache evalCache;
+    Eval::LazyStats lazyStats;
+    Search::AspirationStats aspirationStats;
 };
 
+// Threads is the main thread, the first of ThreadPool
 extern Thread* Threads;
+extern std::vector<Thread*> ThreadPool;
 
 #endif
\ No newline at end of file
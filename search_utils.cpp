@@ -3,24 +3,18 @@
 #include "board.h"
 #include "eval.h"
 #include "tt.h"
+#include "timeman.h"
 #include <cstring>
 #include <cmath>
-#include <chrono>
-
-using namespace std::chrono;
+#include <algorithm>
 
 namespace Search
 {
     static SearchInfo searchInfo;
-    static int history[2][64][64];
-    static Move killerMoves[64][2];
     static int reductions[64][64];
 
     void initTables()
     {
-        memset(history, 0, sizeof(history));
-        memset(killerMoves, 0, sizeof(killerMoves));
-
         for (int depth = 1; depth < 64; ++depth)
             for (int moveCount = 1; moveCount < 64; ++moveCount)
                 reductions[depth][moveCount] = int(0.75 + log(double(depth)) * log(double(moveCount)) / 2.25);
@@ -33,26 +27,20 @@ namespace Search
 
     void initSearch(const Limits& limits, const Position& pos)
     {
-        searchInfo.startTime = steady_clock::now();
-        searchInfo.stopped = false;
-        searchInfo.nodeCount = 0;
-
-        if (limits.movetime > 0)
-        {
-            searchInfo.timeLimit = limits.movetime;
-            searchInfo.maxNodes = 100000000;
-        }
-        else if (limits.time[pos.side_to_move()] > 0)
-        {
-            int timeLeft = limits.time[pos.side_to_move()];
-            searchInfo.timeLimit = timeLeft / 30;
-            searchInfo.maxNodes = 50000000;
-        }
-        else
-        {
-            searchInfo.timeLimit = 60000;
-            searchInfo.maxNodes = 20000000;
-        }
+        Time.init(limits, pos.side_to_move());
+        searchInfo.maxNodes = limits.nodes > 0 ? uint64_t(limits.nodes) : 0;
+        searchInfo.stopLatency = -1;
+
+        // A quarter of the latency bound goes to reaching the next poll; the
+        // rest is left for unwinding, joining the helpers, the vote and the
+        // scheduler. Small node budgets are polled often enough to stay
+        // close to exact.
+        uint64_t interval = 1024;
+        if (searchInfo.nodesPerMs > 0)
+            interval = uint64_t(searchInfo.nodesPerMs * StopLatency / 4);
+        if (searchInfo.maxNodes)
+            interval = std::min(interval, searchInfo.maxNodes / 64);
+        searchInfo.pollInterval = std::max(uint64_t(64), std::min(interval, uint64_t(1) << 20));
     }
 
     Value scoreMove(const Position& pos, Move move, Move ttMove, int ply)
@@ -85,51 +73,64 @@ namespace Search
         if (type_of(move) == CASTLING)
             return 15000;
 
+        const Thread* th = pos.this_thread();
+
         if (ply < 64)
         {
-            if (move == killerMoves[ply][0]) return 9000;
-            if (move == killerMoves[ply][1]) return 8000;
+            if (move == th->killerMoves[ply][0]) return 9000;
+            if (move == th->killerMoves[ply][1]) return 8000;
         }
 
-        return history[pos.side_to_move()][from][to];
+        return th->history[pos.side_to_move()][from][to];
     }
 
-    bool timeUp()
+    // Called at every node, so it only compares the node counter: the clock
+    // is watched by the timer thread, and the stop flag and the node budget
+    // are looked at once per pollInterval nodes. Once a thread has seen the
+    // stop it keeps returning true without looking again.
+    bool timeUp(Thread* th)
     {
-        if (searchInfo.nodeCount > searchInfo.maxNodes) return true;
-        if (searchInfo.timeLimit <= 0) return false;
-        return duration_cast<milliseconds>(steady_clock::now() - searchInfo.startTime).count() >= searchInfo.timeLimit;
+        uint64_t nodes = th->nodes.load(std::memory_order_relaxed);
+        if (nodes < th->nextPoll)
+            return th->stopping;
+
+        th->nextPoll = nodes + searchInfo.pollInterval;
+
+        if (th == Threads && searchInfo.maxNodes && nodes_searched() >= searchInfo.maxNodes)
+            searchInfo.stopped = true;
+
+        return th->stopping = searchInfo.stopped;
     }
 
-    void updateKillers(Move move, int ply)
+    void updateKillers(Thread* th, Move move, int ply)
     {
-        if (ply < 64 && move != killerMoves[ply][0])
+        if (ply < 64 && move != th->killerMoves[ply][0])
         {
-            killerMoves[ply][1] = killerMoves[ply][0];
-            killerMoves[ply][0] = move;
+            th->killerMoves[ply][1] = th->killerMoves[ply][0];
+            th->killerMoves[ply][0] = move;
         }
     }
 
-    void updateHistory(Color us, Square from, Square to, int depth, bool cutoff)
+    void updateHistory(Thread* th, Color us, Square from, Square to, int depth, bool cutoff)
     {
-        int bonus = cutoff ? depth * depth : -depth * depth / 4;
-        history[us][from][to] += bonus;
+        int& h = th->history[us][from][to];
+        h += cutoff ? depth * depth : -depth * depth / 4;
 
-        if (history[us][from][to] > 16000)
-            history[us][from][to] = 16000;
-        else if (history[us][from][to] < -16000)
-            history[us][from][to] = -16000;
+        if (h > 16000)
+            h = 16000;
+        else if (h < -16000)
+            h = -16000;
     }
 
-    void clearKillers()
+    void clearKillers(Thread* th)
     {
-        memset(killerMoves, 0, sizeof(killerMoves));
+        memset(th->killerMoves, 0, sizeof(th->killerMoves));
     }
 
-    Move getKillerMove(int ply, int index)
+    Move getKillerMove(const Thread* th, int ply, int index)
     {
         if (ply < 64 && index < 2)
-            return killerMoves[ply][index];
+            return th->killerMoves[ply][index];
         return MOVE_NONE;
     }
 
@@ -139,4 +140,19 @@ namespace Search
             return reductions[depth][moveCount];
         return 0;
     }
+
+    // Mate scores are stored relative to the node rather than the root, so an
+    // entry found at a different ply still reports the correct mate distance.
+    Value valueToTT(Value v, int ply)
+    {
+        return v >= VALUE_MATE_IN_MAX_PLY ? Value(v + ply)
+            : v <= VALUE_MATED_IN_MAX_PLY ? Value(v - ply) : v;
+    }
+
+    Value valueFromTT(Value v, int ply)
+    {
+        return v == VALUE_NONE ? VALUE_NONE
+            : v >= VALUE_MATE_IN_MAX_PLY ? Value(v - ply)
+            : v <= VALUE_MATED_IN_MAX_PLY ? Value(v + ply) : v;
+    }
 }
\ No newline at end of file
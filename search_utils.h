@@ -13,12 +13,15 @@ namespace Search
     void initTables();
 
     Value scoreMove(const Position& pos, Move move, Move ttMove, int ply);
-    bool timeUp();
-    void updateKillers(Move move, int ply);
-    void updateHistory(Color us, Square from, Square to, int depth, bool cutoff);
-    void clearKillers();
-    Move getKillerMove(int ply, int index);
+    bool timeUp(Thread* th);
+    void updateKillers(Thread* th, Move move, int ply);
+    void updateHistory(Thread* th, Color us, Square from, Square to, int depth, bool cutoff);
+    void clearKillers(Thread* th);
+    Move getKillerMove(const Thread* th, int ply, int index);
     int getReduction(int depth, int moveCount);
+
+    Value valueToTT(Value v, int ply);
+    Value valueFromTT(Value v, int ply);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,1163 @@
+#include "syzygy.h"
+#include "board.h"
+#include "bitboard.h"
+#include "move.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Tablebases
+{
+    int MaxCardinality = 0;
+    int ProbeDepth = 1;
+}
+
+namespace
+{
+    using namespace Tablebases;
+
+    constexpr int TBPieces = 6;
+
+    enum TBType { WDL, DTZ };
+
+    // Per-table flags, first byte of each table's size block
+    enum TBFlag { STM = 1, Mapped = 2, WinPlies = 4, LossPlies = 8, Wide = 16, SingleValue = 128 };
+
+    const uint8_t WDLMagic[] = { 0x71, 0xE8, 0x23, 0x5D };
+    const uint8_t DTZMagic[] = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+    // Encoding tables, filled in by init_indices()
+    int MapB1H1H7[SQUARE_NB];
+    int MapA1D1D4[SQUARE_NB];
+    int MapKK[10][SQUARE_NB];
+    int MapPawns[SQUARE_NB];
+    uint64_t Binomial[TBPieces][SQUARE_NB];
+    uint64_t LeadPawnIdx[TBPieces][SQUARE_NB];
+    uint64_t LeadPawnsSize[TBPieces][4];
+
+    // File contents are little-endian apart from the Huffman-coded blocks,
+    // which are read as big-endian words.
+    template<typename T>
+    T read_le(const void* addr)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(addr);
+        T v = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+            v |= T(p[i]) << (8 * i);
+        return v;
+    }
+
+    template<typename T>
+    T read_be(const void* addr)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(addr);
+        T v = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+            v = T(v << 8) | p[i];
+        return v;
+    }
+
+    // Signed distance of s from the a1-h8 diagonal: negative below it
+    inline int off_diagonal(int s) { return (s >> 3) - (s & 7); }
+    inline int flip_file(int s) { return s ^ 7; }
+    inline int flip_rank(int s) { return s ^ 56; }
+    inline int edge_file(int s) { return std::min(s & 7, 7 - (s & 7)); }
+    inline int sign_of(int x) { return (x > 0) - (x < 0); }
+
+    bool pawn_before(int a, int b) { return MapPawns[a] < MapPawns[b]; }
+
+    typedef uint16_t Sym;
+
+    // A symbol of the pairing grammar: two 12-bit children, or a leaf whose
+    // left field is the stored value and right field 0xFFF.
+    struct LR
+    {
+        uint8_t lr[3];
+
+        Sym left() const { return Sym(((lr[1] & 0xF) << 8) | lr[0]); }
+        Sym right() const { return Sym((lr[2] << 4) | (lr[1] >> 4)); }
+    };
+
+    // For every span-th index, the block it lies in and its offset there
+    struct SparseEntry
+    {
+        uint8_t block[4];
+        uint8_t offset[2];
+    };
+
+    static_assert(sizeof(LR) == 3 && sizeof(SparseEntry) == 6, "packed table structures");
+
+    // One compressed table: a side to move and, with pawns, a leading file
+    struct PairsData
+    {
+        uint8_t flags;
+        size_t sizeofBlock;
+        size_t span;
+        uint32_t numBlocks;
+        int maxSymLen;
+        int minSymLen;
+        const Sym* lowestSym;
+        const LR* btree;
+        const uint16_t* blockLength;
+        uint32_t blockLengthSize;
+        const SparseEntry* sparseIndex;
+        size_t sparseIndexSize;
+        const uint8_t* data;
+        std::vector<uint64_t> base64;
+        std::vector<uint8_t> symlen;
+        Piece pieces[TBPieces];
+        uint64_t groupIdx[TBPieces + 1];
+        int groupLen[TBPieces + 1];
+        uint16_t mapIdx[4];
+    };
+
+    // The WDL or DTZ file of one material signature, e.g. KRPvKR. The file
+    // stores positions with the first-named side as White; key is that
+    // signature's material key and key2 the one with colours swapped.
+    struct Table
+    {
+        Table(const std::string& code, TBType t);
+        ~Table();
+
+        bool map(const std::string& fileName);
+        PairsData* get(int stm, int file) { return &items[stm % sides][hasPawns ? file : 0]; }
+
+        TBType type;
+        std::string code;
+        Key key, key2;
+        int pieceCount;
+        int pawnCount[2];
+        bool hasPawns;
+        bool hasUniquePieces;
+        int sides;
+        const uint8_t* dtzMap = nullptr;
+        PairsData items[2][4];
+
+        std::atomic<bool> ready{ false };
+        bool failed = false;
+        std::mutex mutex;
+        void* base = nullptr;
+        size_t size = 0;
+        void* handle = nullptr;
+    };
+
+    std::vector<std::string> Paths;
+    std::deque<Table> WDLTables, DTZTables;
+    std::unordered_map<Key, std::pair<Table*, Table*>> Lookup;
+
+    Table::Table(const std::string& c, TBType t) : type(t), code(c)
+    {
+        StateInfo st;
+        Position pos;
+
+        key = pos.set(code, WHITE, &st).material_key();
+        pieceCount = popcount(pos.pieces());
+        hasPawns = pos.pieces(PAWN) != 0;
+
+        hasUniquePieces = false;
+        for (Color col = WHITE; col <= BLACK; ++col)
+            for (PieceType pt = PAWN; pt < KING; ++pt)
+                if (popcount(pos.pieces(col, pt)) == 1)
+                    hasUniquePieces = true;
+
+        // With pawns on both sides the side with fewer pawns leads, which
+        // compresses better.
+        int wp = pos.count<PAWN>(WHITE), bp = pos.count<PAWN>(BLACK);
+        bool whiteLeads = !bp || (wp && bp >= wp);
+        pawnCount[0] = whiteLeads ? wp : bp;
+        pawnCount[1] = whiteLeads ? bp : wp;
+
+        key2 = pos.set(code, BLACK, &st).material_key();
+        sides = type == WDL && key != key2 ? 2 : 1;
+    }
+
+    Table::~Table()
+    {
+        if (!base)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(static_cast<HANDLE>(handle));
+#else
+        munmap(base, size);
+#endif
+    }
+
+    // Returns the mapped file, or nullptr. Valid files are 16 bytes past a
+    // multiple of 64 and start with the magic of their type.
+#ifdef _WIN32
+    const uint8_t* map_file(const std::string& name, TBType type, void*& base, size_t& size, void*& handle)
+#else
+    const uint8_t* map_file(const std::string& name, TBType type, void*& base, size_t& size, void*&)
+#endif
+    {
+        for (const std::string& dir : Paths)
+        {
+            std::string path = dir + "/" + name;
+#ifdef _WIN32
+            HANDLE fd = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+            if (fd == INVALID_HANDLE_VALUE)
+                continue;
+
+            DWORD high;
+            DWORD low = GetFileSize(fd, &high);
+            size = size_t((uint64_t(high) << 32) | low);
+            HANDLE mapping = size ? CreateFileMappingA(fd, nullptr, PAGE_READONLY, high, low, nullptr) : nullptr;
+            CloseHandle(fd);
+            if (!mapping)
+                continue;
+
+            base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (!base)
+            {
+                CloseHandle(mapping);
+                continue;
+            }
+            handle = mapping;
+#else
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                continue;
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0)
+            {
+                close(fd);
+                continue;
+            }
+
+            size = size_t(st.st_size);
+            base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (base == MAP_FAILED)
+            {
+                base = nullptr;
+                continue;
+            }
+#ifdef MADV_RANDOM
+            madvise(base, size, MADV_RANDOM);
+#endif
+#endif
+            const uint8_t* data = static_cast<const uint8_t*>(base);
+            const uint8_t* magic = type == WDL ? WDLMagic : DTZMagic;
+
+            if (size % 64 == 16 && std::memcmp(data, magic, 4) == 0)
+                return data;
+
+            std::cout << "info string Corrupted tablebase file " << path << std::endl;
+#ifdef _WIN32
+            UnmapViewOfFile(base);
+            CloseHandle(mapping);
+#else
+            munmap(base, size);
+#endif
+            base = nullptr;
+        }
+
+        return nullptr;
+    }
+
+    // Group the pieces of d->pieces as the encoder did and compute each
+    // group's multiplier in the index. The first group is the kings plus, if
+    // some piece is unique, one more (a triple is encoded jointly), or the
+    // leading pawns; identical pieces that follow form one group each.
+    void set_groups(Table& e, PairsData* d, const int order[2], int file)
+    {
+        int n = 0, firstLen = e.hasPawns ? 0 : e.hasUniquePieces ? 3 : 2;
+        d->groupLen[n] = 1;
+
+        for (int i = 1; i < e.pieceCount; ++i)
+            if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1])
+                d->groupLen[n]++;
+            else
+                d->groupLen[++n] = 1;
+
+        d->groupLen[++n] = 0;
+
+        // The groups are combined in the order the file gives: order[0] is
+        // the position of the leading group and order[1] that of the other
+        // side's pawns when both sides have them.
+        bool pp = e.hasPawns && e.pawnCount[1];
+        int next = pp ? 2 : 1;
+        int freeSquares = 64 - d->groupLen[0] - (pp ? d->groupLen[1] : 0);
+        uint64_t idx = 1;
+
+        for (int k = 0; next < n || k == order[0] || k == order[1]; ++k)
+            if (k == order[0])
+            {
+                d->groupIdx[0] = idx;
+                idx *= e.hasPawns ? LeadPawnsSize[d->groupLen[0]][file]
+                    : e.hasUniquePieces ? 31332 : 462;
+            }
+            else if (k == order[1])
+            {
+                d->groupIdx[1] = idx;
+                idx *= Binomial[d->groupLen[1]][48 - d->groupLen[0]];
+            }
+            else
+            {
+                d->groupIdx[next] = idx;
+                idx *= Binomial[d->groupLen[next]][freeSquares];
+                freeSquares -= d->groupLen[next++];
+            }
+
+        d->groupIdx[n] = idx;
+    }
+
+    // Number of values a symbol expands to, minus one
+    int set_symlen(PairsData* d, Sym s, std::vector<bool>& visited)
+    {
+        visited[s] = true;
+
+        Sym sr = d->btree[s].right();
+        if (sr == 0xFFF)
+            return 0;
+
+        Sym sl = d->btree[s].left();
+        if (!visited[sl])
+            d->symlen[sl] = uint8_t(set_symlen(d, sl, visited));
+        if (!visited[sr])
+            d->symlen[sr] = uint8_t(set_symlen(d, sr, visited));
+
+        return d->symlen[sl] + d->symlen[sr] + 1;
+    }
+
+    const uint8_t* set_sizes(PairsData* d, const uint8_t* data)
+    {
+        d->flags = *data++;
+
+        if (d->flags & SingleValue)
+        {
+            d->numBlocks = 0;
+            d->span = 0;
+            d->sparseIndexSize = 0;
+            d->blockLengthSize = 0;
+            d->sizeofBlock = 0;
+            d->maxSymLen = 0;
+            d->minSymLen = *data++; // The value of every position
+            return data;
+        }
+
+        uint64_t tbSize = d->groupIdx[std::find(d->groupLen, d->groupLen + TBPieces + 1, 0) - d->groupLen];
+
+        d->sizeofBlock = size_t(1) << *data++;
+        d->span = size_t(1) << *data++;
+        d->sparseIndexSize = size_t((tbSize + d->span - 1) / d->span);
+        int padding = *data++;
+        d->numBlocks = read_le<uint32_t>(data); data += 4;
+        d->blockLengthSize = d->numBlocks + padding;
+        d->maxSymLen = *data++;
+        d->minSymLen = *data++;
+        d->lowestSym = reinterpret_cast<const Sym*>(data);
+
+        // Canonical Huffman code: longer codes have smaller values. base64[l]
+        // is the smallest code of length minSymLen + l left-aligned in 64
+        // bits, so a buffer's code length is the first l with buf >= base64[l].
+        d->base64.assign(d->maxSymLen - d->minSymLen + 1, 0);
+        for (int i = int(d->base64.size()) - 2; i >= 0; --i)
+            d->base64[i] = (d->base64[i + 1] + read_le<Sym>(d->lowestSym + i)
+                - read_le<Sym>(d->lowestSym + i + 1)) / 2;
+
+        for (size_t i = 0; i < d->base64.size(); ++i)
+            d->base64[i] <<= 64 - i - d->minSymLen;
+
+        data += d->base64.size() * sizeof(Sym);
+
+        d->symlen.assign(read_le<uint16_t>(data), 0); data += 2;
+        d->btree = reinterpret_cast<const LR*>(data);
+
+        std::vector<bool> visited(d->symlen.size());
+        for (Sym s = 0; s < d->symlen.size(); ++s)
+            if (!visited[s])
+                d->symlen[s] = uint8_t(set_symlen(d, s, visited));
+
+        return data + d->symlen.size() * sizeof(LR) + (d->symlen.size() & 1);
+    }
+
+    // DTZ values may be stored through per-file maps, one for each of the
+    // four non-draw results.
+    const uint8_t* set_dtz_map(Table& e, const uint8_t* data, int maxFile)
+    {
+        e.dtzMap = data;
+
+        for (int f = 0; f <= maxFile; ++f)
+        {
+            PairsData* d = e.get(0, f);
+            if (!(d->flags & Mapped))
+                continue;
+
+            if (d->flags & Wide)
+            {
+                data += uintptr_t(data) & 1;
+                for (int i = 0; i < 4; ++i)
+                {
+                    d->mapIdx[i] = uint16_t((data - e.dtzMap) / 2 + 1);
+                    data += 2 * read_le<uint16_t>(data) + 2;
+                }
+            }
+            else
+                for (int i = 0; i < 4; ++i)
+                {
+                    d->mapIdx[i] = uint16_t(data - e.dtzMap + 1);
+                    data += *data + 1;
+                }
+        }
+
+        return data + (uintptr_t(data) & 1);
+    }
+
+    // Lays the table structures over the mapped file
+    void set_tables(Table& e, const uint8_t* data)
+    {
+        data += 5; // Magic and a flags byte
+
+        int maxFile = e.hasPawns ? 3 : 0;
+        bool pp = e.hasPawns && e.pawnCount[1];
+
+        for (int f = 0; f <= maxFile; ++f)
+        {
+            for (int i = 0; i < e.sides; ++i)
+                e.items[i][f] = PairsData();
+
+            int order[2][2] = { { *data & 0xF, pp ? *(data + 1) & 0xF : 0xF },
+                                { *data >> 4, pp ? *(data + 1) >> 4 : 0xF } };
+            data += 1 + pp;
+
+            for (int k = 0; k < e.pieceCount; ++k, ++data)
+                for (int i = 0; i < e.sides; ++i)
+                    e.get(i, f)->pieces[k] = Piece(i ? *data >> 4 : *data & 0xF);
+
+            for (int i = 0; i < e.sides; ++i)
+                set_groups(e, e.get(i, f), order[i], f);
+        }
+
+        data += uintptr_t(data) & 1;
+
+        for (int f = 0; f <= maxFile; ++f)
+            for (int i = 0; i < e.sides; ++i)
+                data = set_sizes(e.get(i, f), data);
+
+        if (e.type == DTZ)
+            data = set_dtz_map(e, data, maxFile);
+
+        for (int f = 0; f <= maxFile; ++f)
+            for (int i = 0; i < e.sides; ++i)
+            {
+                PairsData* d = e.get(i, f);
+                d->sparseIndex = reinterpret_cast<const SparseEntry*>(data);
+                data += d->sparseIndexSize * sizeof(SparseEntry);
+            }
+
+        for (int f = 0; f <= maxFile; ++f)
+            for (int i = 0; i < e.sides; ++i)
+            {
+                PairsData* d = e.get(i, f);
+                d->blockLength = reinterpret_cast<const uint16_t*>(data);
+                data += d->blockLengthSize * sizeof(uint16_t);
+            }
+
+        for (int f = 0; f <= maxFile; ++f)
+            for (int i = 0; i < e.sides; ++i)
+            {
+                data = reinterpret_cast<const uint8_t*>((uintptr_t(data) + 0x3F) & ~uintptr_t(0x3F));
+                PairsData* d = e.get(i, f);
+                d->data = data;
+                data += size_t(d->numBlocks) * d->sizeofBlock;
+            }
+    }
+
+    bool Table::map(const std::string& fileName)
+    {
+        if (ready.load(std::memory_order_acquire))
+            return true;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (ready.load(std::memory_order_relaxed))
+            return true;
+        if (failed)
+            return false;
+
+        const uint8_t* data = map_file(fileName, type, base, size, handle);
+        if (!data)
+            return !(failed = true);
+
+        set_tables(*this, data);
+        ready.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // Value number idx of table d. Blocks are sequences of Huffman-coded
+    // symbols, each expanding to symlen + 1 consecutive values.
+    int decompress_pairs(PairsData* d, uint64_t idx)
+    {
+        if (d->flags & SingleValue)
+            return d->minSymLen;
+
+        // The sparse index gives, for the middle index of each span, its
+        // block and offset; walk from there to the block holding idx.
+        uint32_t k = uint32_t(idx / d->span);
+        uint32_t block = read_le<uint32_t>(d->sparseIndex[k].block);
+        int offset = read_le<uint16_t>(d->sparseIndex[k].offset);
+        offset += int(idx % d->span) - int(d->span / 2);
+
+        while (offset < 0)
+            offset += read_le<uint16_t>(d->blockLength + --block) + 1;
+
+        while (offset > read_le<uint16_t>(d->blockLength + block))
+            offset -= read_le<uint16_t>(d->blockLength + block++) + 1;
+
+        const uint8_t* ptr = d->data + uint64_t(block) * d->sizeofBlock;
+        uint64_t buf64 = read_be<uint64_t>(ptr);
+        ptr += 8;
+        int buf64Size = 64;
+        Sym sym;
+
+        while (true)
+        {
+            int len = 0;
+            while (buf64 < d->base64[len])
+                ++len;
+
+            sym = Sym((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+            sym = Sym(sym + read_le<Sym>(d->lowestSym + len));
+
+            if (offset < d->symlen[sym] + 1)
+                break;
+
+            offset -= d->symlen[sym] + 1;
+            len += d->minSymLen;
+            buf64 <<= len;
+            buf64Size -= len;
+
+            if (buf64Size <= 32)
+            {
+                buf64Size += 32;
+                buf64 |= uint64_t(read_be<uint32_t>(ptr)) << (64 - buf64Size);
+                ptr += 4;
+            }
+        }
+
+        // Descend the pairs to the leaf holding the value
+        while (d->symlen[sym])
+        {
+            Sym left = d->btree[sym].left();
+
+            if (offset < d->symlen[left] + 1)
+                sym = left;
+            else
+            {
+                offset -= d->symlen[left] + 1;
+                sym = d->btree[sym].right();
+            }
+        }
+
+        return d->btree[sym].left();
+    }
+
+    bool check_dtz_stm(Table* e, int stm, int file)
+    {
+        if (e->type == WDL)
+            return true;
+
+        return (e->get(stm, file)->flags & STM) == stm
+            || (e->key == e->key2 && !e->hasPawns);
+    }
+
+    // Converts a stored value to a WDL score, or to a DTZ in plies
+    int map_score(Table* e, int file, int value, WDLScore wdl)
+    {
+        if (e->type == WDL)
+            return value - 2;
+
+        static const int WDLMap[] = { 1, 3, 0, 2, 0 };
+        PairsData* d = e->get(0, file);
+
+        if (d->flags & Mapped)
+        {
+            int i = d->mapIdx[WDLMap[wdl + 2]] + value;
+            value = d->flags & Wide ? read_le<uint16_t>(e->dtzMap + 2 * i) : e->dtzMap[i];
+        }
+
+        if ((wdl == WDLWin && !(d->flags & WinPlies))
+            || (wdl == WDLLoss && !(d->flags & LossPlies))
+            || wdl == WDLCursedWin
+            || wdl == WDLBlessedLoss)
+            value *= 2;
+
+        return value + 1;
+    }
+
+    // The position's index in its table, with d and file set to the part
+    // of the table holding it. The position is first brought to the table's
+    // colours (the stronger side as White) and then mirrored to its
+    // canonical form. Returns false if a DTZ table lacks this side to move.
+    bool encode(const Position& pos, Table* e, PairsData*& d, int& file, uint64_t& idx)
+    {
+        int squares[TBPieces];
+        Piece pieces[TBPieces];
+        int size = 0, leadPawnsCnt = 0;
+        Bitboard b, leadPawns = 0;
+
+        file = 0;
+
+        // Tables with the same material on both sides only store White to
+        // move, and every table stores the stronger side as White.
+        bool symmetricBlackToMove = e->key == e->key2 && pos.side_to_move() == BLACK;
+        bool flip = symmetricBlackToMove || pos.material_key() != e->key;
+        int flipColor = flip ? 8 : 0;
+        int flipSquares = flip ? 56 : 0;
+        int stm = int(flip) ^ int(pos.side_to_move());
+
+        // With pawns there is a table per file of the leading pawn, the one
+        // with the highest MapPawns value.
+        if (e->hasPawns)
+        {
+            Piece pc = Piece(e->get(0, 0)->pieces[0] ^ flipColor);
+            leadPawns = b = pos.pieces(color_of(pc), PAWN);
+
+            while (b)
+                squares[size++] = pop_lsb(b) ^ flipSquares;
+
+            leadPawnsCnt = size;
+            std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCnt, pawn_before));
+            file = edge_file(squares[0]);
+        }
+
+        if (!check_dtz_stm(e, stm, file))
+            return false;
+
+        b = pos.pieces() ^ leadPawns;
+        while (b)
+        {
+            Square s = pop_lsb(b);
+            squares[size] = s ^ flipSquares;
+            pieces[size++] = Piece(pos.piece_on(s) ^ flipColor);
+        }
+
+        d = e->get(stm, file);
+
+        // Order the pieces as the table lists them
+        for (int i = leadPawnsCnt; i < size - 1; ++i)
+            for (int j = i + 1; j < size; ++j)
+                if (d->pieces[i] == pieces[j])
+                {
+                    std::swap(pieces[i], pieces[j]);
+                    std::swap(squares[i], squares[j]);
+                    break;
+                }
+
+        // Mirror so that the leading piece is on files a-d
+        if ((squares[0] & 7) > 3)
+            for (int i = 0; i < size; ++i)
+                squares[i] = flip_file(squares[i]);
+
+        if (e->hasPawns)
+        {
+            idx = LeadPawnIdx[leadPawnsCnt][squares[0]];
+            std::stable_sort(squares + 1, squares + leadPawnsCnt, pawn_before);
+
+            for (int i = 1; i < leadPawnsCnt; ++i)
+                idx += Binomial[i][MapPawns[squares[i]]];
+        }
+        else
+        {
+            // Without pawns also mirror to ranks 1-4 and then, at the first
+            // leading piece off the a1-h8 diagonal, to below it.
+            if ((squares[0] >> 3) > 3)
+                for (int i = 0; i < size; ++i)
+                    squares[i] = flip_rank(squares[i]);
+
+            for (int i = 0; i < d->groupLen[0]; ++i)
+            {
+                if (!off_diagonal(squares[i]))
+                    continue;
+
+                if (off_diagonal(squares[i]) > 0)
+                    for (int j = i; j < size; ++j)
+                        squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+                break;
+            }
+
+            if (e->hasUniquePieces)
+            {
+                // Three pieces together: the first in the a1-d1-d4 triangle
+                // and the others on the remaining squares, with separate
+                // ranges for pieces on the diagonal.
+                int adjust1 = squares[1] > squares[0];
+                int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+                if (off_diagonal(squares[0]))
+                    idx = (MapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62
+                        + squares[2] - adjust2;
+                else if (off_diagonal(squares[1]))
+                    idx = (6 * 63 + (squares[0] >> 3) * 28 + MapB1H1H7[squares[1]]) * 62
+                        + squares[2] - adjust2;
+                else if (off_diagonal(squares[2]))
+                    idx = 6 * 63 * 62 + 4 * 28 * 62
+                        + (squares[0] >> 3) * 7 * 28
+                        + ((squares[1] >> 3) - adjust1) * 28
+                        + MapB1H1H7[squares[2]];
+                else
+                    idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28
+                        + (squares[0] >> 3) * 7 * 6
+                        + ((squares[1] >> 3) - adjust1) * 6
+                        + ((squares[2] >> 3) - adjust2);
+            }
+            else
+                idx = MapKK[MapA1D1D4[squares[0]]][squares[1]];
+        }
+
+        idx *= d->groupIdx[0];
+
+        // The remaining groups, each as a combination of squares not taken
+        // by earlier groups; the other side's pawns cannot use rank 1.
+        int* groupSq = squares + d->groupLen[0];
+        bool remainingPawns = e->hasPawns && e->pawnCount[1];
+
+        for (int next = 1; d->groupLen[next]; ++next)
+        {
+            std::stable_sort(groupSq, groupSq + d->groupLen[next]);
+            uint64_t n = 0;
+
+            for (int i = 0; i < d->groupLen[next]; ++i)
+            {
+                int adjust = int(std::count_if(squares, groupSq, [&](int s) { return groupSq[i] > s; }));
+                n += Binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+            }
+
+            remainingPawns = false;
+            idx += n * d->groupIdx[next];
+            groupSq += d->groupLen[next];
+        }
+
+        return true;
+    }
+
+    int probe_table(const Position& pos, Table* e, WDLScore wdl, ProbeState* result)
+    {
+        PairsData* d;
+        int file;
+        uint64_t idx;
+
+        if (!encode(pos, e, d, file, idx))
+            return *result = CHANGE_STM, 0;
+
+        return map_score(e, file, decompress_pairs(d, idx), wdl);
+    }
+
+    int probe(const Position& pos, TBType type, WDLScore wdl, ProbeState* result)
+    {
+        if (popcount(pos.pieces()) == 2)
+            return WDLDraw;
+
+        auto it = Lookup.find(pos.material_key());
+        if (it == Lookup.end())
+            return *result = FAIL, 0;
+
+        Table* e = type == WDL ? it->second.first : it->second.second;
+        if (!e->map(e->code + (type == WDL ? ".rtbw" : ".rtbz")))
+            return *result = FAIL, 0;
+
+        return probe_table(pos, e, wdl, result);
+    }
+
+    bool is_capture(const Position& pos, Move m)
+    {
+        return pos.piece_on(to_sq(m)) != NO_PIECE || type_of(m) == ENPASSANT;
+    }
+
+    // MoveList is pseudo-legal, so every loop below filters with legal()
+    size_t legal_move_count(const Position& pos)
+    {
+        size_t n = 0;
+        for (const auto& move : MoveList(pos))
+            n += pos.legal(move);
+        return n;
+    }
+
+    // The generator stores "don't care" values where a capture (or, for
+    // DTZ, any zeroing move) already decides the result, so those moves are
+    // resolved by search and the stored value only bounds the rest. With
+    // CheckZeroingMoves pawn moves count as well, and *result is set to
+    // ZEROING_BEST_MOVE when such a move is best.
+    template<bool CheckZeroingMoves>
+    WDLScore search(Position& pos, ProbeState* result)
+    {
+        WDLScore value, bestValue = WDLLoss;
+        StateInfo st;
+        MoveList moveList(pos);
+        size_t moveCount = 0, legalCount = 0;
+
+        for (const auto& move : moveList)
+        {
+            if (!pos.legal(move))
+                continue;
+
+            ++legalCount;
+
+            if (!is_capture(pos, move)
+                && (!CheckZeroingMoves || type_of(pos.moved_piece(move)) != PAWN))
+                continue;
+
+            ++moveCount;
+
+            pos.do_move(move, st);
+            value = WDLScore(-search<false>(pos, result));
+            pos.undo_move(move);
+
+            if (*result == FAIL)
+                return WDLDraw;
+
+            if (value > bestValue)
+            {
+                bestValue = value;
+
+                if (value >= WDLWin)
+                {
+                    *result = ZEROING_BEST_MOVE;
+                    return value;
+                }
+            }
+        }
+
+        // When every move was searched the stored value is not needed, and
+        // may be wrong, e.g. for positions with an en passant capture.
+        bool noMoreMoves = moveCount && moveCount == legalCount;
+
+        if (noMoreMoves)
+            value = bestValue;
+        else
+        {
+            value = WDLScore(probe(pos, WDL, WDLDraw, result));
+            if (*result == FAIL)
+                return WDLDraw;
+        }
+
+        if (bestValue >= value)
+            return *result = (bestValue > WDLDraw || noMoreMoves ? ZEROING_BEST_MOVE : OK), bestValue;
+
+        return *result = OK, value;
+    }
+
+    // DTZ of a position whose best move zeroes the counter
+    int dtz_before_zeroing(WDLScore wdl)
+    {
+        return wdl == WDLWin ? 1
+            : wdl == WDLCursedWin ? 101
+            : wdl == WDLBlessedLoss ? -101
+            : wdl == WDLLoss ? -1 : 0;
+    }
+
+    void init_indices()
+    {
+        int code = 0;
+        for (int s = 0; s < SQUARE_NB; ++s)
+            if (off_diagonal(s) < 0)
+                MapB1H1H7[s] = code++;
+
+        // The a1-d1-d4 triangle: squares below the diagonal first
+        std::vector<int> diagonal;
+        code = 0;
+        for (int s = 0; s <= SQ_D4; ++s)
+            if (off_diagonal(s) < 0 && (s & 7) <= 3)
+                MapA1D1D4[s] = code++;
+            else if (!off_diagonal(s) && (s & 7) <= 3)
+                diagonal.push_back(s);
+
+        for (int s : diagonal)
+            MapA1D1D4[s] = code++;
+
+        // The 462 legal, non-mirrored placements of two kings with the first
+        // in the triangle; if it is on the diagonal the second is not above
+        // it. Both on the diagonal come last.
+        std::vector<std::pair<int, int>> bothOnDiagonal;
+        code = 0;
+        for (int idx = 0; idx < 10; ++idx)
+            for (int s1 = 0; s1 <= SQ_D4; ++s1)
+                if (MapA1D1D4[s1] == idx && (idx || s1 == SQ_B1))
+                    for (int s2 = 0; s2 < SQUARE_NB; ++s2)
+                    {
+                        if ((PseudoAttacks[KING][s1] | square_bb(Square(s1))) & square_bb(Square(s2)))
+                            continue;
+                        if (!off_diagonal(s1) && off_diagonal(s2) > 0)
+                            continue;
+                        if (!off_diagonal(s1) && !off_diagonal(s2))
+                            bothOnDiagonal.emplace_back(idx, s2);
+                        else
+                            MapKK[idx][s2] = code++;
+                    }
+
+        for (auto& p : bothOnDiagonal)
+            MapKK[p.first][p.second] = code++;
+
+        Binomial[0][0] = 1;
+        for (int n = 1; n < SQUARE_NB; ++n)
+            for (int k = 0; k < TBPieces && k <= n; ++k)
+                Binomial[k][n] = (k > 0 ? Binomial[k - 1][n - 1] : 0)
+                    + (k < n ? Binomial[k][n - 1] : 0);
+
+        // Pawn squares a2-h7 numbered so that a higher MapPawns means nearer
+        // the edge and, on the same file, lower: the leading pawn has the
+        // highest. Leading pawn groups are indexed per file.
+        int available = 47;
+        for (int cnt = 1; cnt < TBPieces; ++cnt)
+            for (int f = 0; f < 4; ++f)
+            {
+                uint64_t idx = 0;
+                for (int r = 1; r <= 6; ++r)
+                {
+                    int s = r * 8 + f;
+                    if (cnt == 1)
+                    {
+                        MapPawns[s] = available--;
+                        MapPawns[flip_file(s)] = available--;
+                    }
+                    LeadPawnIdx[cnt][s] = idx;
+                    idx += Binomial[cnt - 1][MapPawns[s]];
+                }
+                LeadPawnsSize[cnt][f] = idx;
+            }
+    }
+
+    // Registers a table if its WDL file exists. pieces lists the stronger
+    // side, from its king, then the other side.
+    void add(const std::vector<PieceType>& pieces)
+    {
+        const char PieceChars[] = " PNBRQK";
+        std::string code;
+
+        for (PieceType pt : pieces)
+            code += PieceChars[pt];
+        code.insert(code.find('K', 1), "v");
+
+        void* base = nullptr;
+        void* handle = nullptr;
+        size_t size = 0;
+        if (!map_file(code + ".rtbw", WDL, base, size, handle))
+            return;
+
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(static_cast<HANDLE>(handle));
+#else
+        munmap(base, size);
+#endif
+
+        MaxCardinality = std::max(int(pieces.size()), MaxCardinality);
+
+        WDLTables.emplace_back(code, WDL);
+        DTZTables.emplace_back(code, DTZ);
+        Lookup[WDLTables.back().key] = std::make_pair(&WDLTables.back(), &DTZTables.back());
+        Lookup[WDLTables.back().key2] = std::make_pair(&WDLTables.back(), &DTZTables.back());
+    }
+}
+
+namespace Tablebases
+{
+    void init(const std::string& paths)
+    {
+        static bool indicesReady = false;
+        if (!indicesReady)
+        {
+            init_indices();
+            indicesReady = true;
+        }
+
+        Lookup.clear();
+        WDLTables.clear();
+        DTZTables.clear();
+        Paths.clear();
+        MaxCardinality = 0;
+
+        if (paths.empty() || paths == "<empty>")
+            return;
+
+#ifdef _WIN32
+        const char separator = ';';
+#else
+        const char separator = ':';
+#endif
+        std::stringstream ss(paths);
+        std::string dir;
+        while (std::getline(ss, dir, separator))
+            if (!dir.empty())
+                Paths.push_back(dir);
+
+        for (PieceType p1 = PAWN; p1 < KING; ++p1)
+        {
+            add({ KING, p1, KING });
+
+            for (PieceType p2 = PAWN; p2 <= p1; ++p2)
+            {
+                add({ KING, p1, p2, KING });
+                add({ KING, p1, KING, p2 });
+
+                for (PieceType p3 = PAWN; p3 < KING; ++p3)
+                    add({ KING, p1, p2, KING, p3 });
+
+                for (PieceType p3 = PAWN; p3 <= p2; ++p3)
+                {
+                    add({ KING, p1, p2, p3, KING });
+
+                    for (PieceType p4 = PAWN; p4 <= p3; ++p4)
+                        add({ KING, p1, p2, p3, p4, KING });
+
+                    for (PieceType p4 = PAWN; p4 < KING; ++p4)
+                        add({ KING, p1, p2, p3, KING, p4 });
+                }
+
+                for (PieceType p3 = PAWN; p3 <= p1; ++p3)
+                    for (PieceType p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); ++p4)
+                        add({ KING, p1, p2, KING, p3, p4 });
+            }
+        }
+
+        std::cout << "info string Found " << WDLTables.size() << " tablebases" << std::endl;
+    }
+
+    WDLScore probe_wdl(Position& pos, ProbeState* result)
+    {
+        *result = OK;
+        return search<false>(pos, result);
+    }
+
+    // DTZ in plies, signed like the WDL score; 100 is added to cursed wins
+    // and blessed losses.
+    int probe_dtz(Position& pos, ProbeState* result)
+    {
+        *result = OK;
+        WDLScore wdl = search<true>(pos, result);
+
+        if (*result == FAIL || wdl == WDLDraw)
+            return 0;
+
+        if (*result == ZEROING_BEST_MOVE)
+            return dtz_before_zeroing(wdl);
+
+        int dtz = probe(pos, DTZ, wdl, result);
+
+        if (*result == FAIL)
+            return 0;
+
+        if (*result != CHANGE_STM)
+            return (dtz + 100 * (wdl == WDLBlessedLoss || wdl == WDLCursedWin)) * sign_of(wdl);
+
+        // The table is for the other side: take the best DTZ over the moves
+        StateInfo st;
+        int minDTZ = 0xFFFF;
+
+        for (const auto& move : MoveList(pos))
+        {
+            if (!pos.legal(move))
+                continue;
+
+            bool zeroing = is_capture(pos, move) || type_of(pos.moved_piece(move)) == PAWN;
+
+            pos.do_move(move, st);
+
+            // After a zeroing move only the result matters
+            dtz = zeroing ? -dtz_before_zeroing(search<false>(pos, result))
+                : -probe_dtz(pos, result);
+
+            if (dtz == 1 && pos.checkers() && legal_move_count(pos) == 0)
+                minDTZ = 1;
+
+            if (!zeroing)
+                dtz += sign_of(dtz);
+
+            if (dtz < minDTZ && sign_of(dtz) == sign_of(wdl))
+                minDTZ = dtz;
+
+            pos.undo_move(move);
+
+            if (*result == FAIL)
+                return 0;
+        }
+
+        return minDTZ == 0xFFFF ? -1 : minDTZ;
+    }
+
+    bool root_probe(Position& pos, std::vector<Move>& moves, bool& usedDTZ)
+    {
+        if (moves.empty())
+            return false;
+
+        std::vector<int> rank(moves.size());
+        ProbeState result = OK;
+        StateInfo st;
+        int cnt50 = pos.rule50_count();
+
+        // Rank by DTZ where available. Wins the 50-move rule lets through
+        // rank above cursed ones, and sooner ones above later ones; losses
+        // the other way round.
+        usedDTZ = true;
+        for (size_t i = 0; i < moves.size() && usedDTZ; ++i)
+        {
+            pos.do_move(moves[i], st);
+
+            int dtz;
+            if (pos.rule50_count() == 0)
+                dtz = dtz_before_zeroing(WDLScore(-probe_wdl(pos, &result)));
+            else if (pos.is_draw(1))
+                dtz = 0;
+            else
+            {
+                dtz = -probe_dtz(pos, &result);
+                dtz += sign_of(dtz);
+            }
+
+            if (pos.checkers() && dtz == 2 && legal_move_count(pos) == 0)
+                dtz = 1;
+
+            pos.undo_move(moves[i]);
+
+            if (result == FAIL)
+                usedDTZ = false;
+
+            rank[i] = dtz > 0 ? (dtz + cnt50 <= 100 ? 2000 : 1000) - dtz
+                : dtz < 0 ? (-dtz + cnt50 <= 100 ? -2000 : -1000) - dtz
+                : 0;
+        }
+
+        // Without DTZ tables keep the moves with the best result
+        if (!usedDTZ)
+            for (size_t i = 0; i < moves.size(); ++i)
+            {
+                pos.do_move(moves[i], st);
+                rank[i] = -probe_wdl(pos, &result);
+                pos.undo_move(moves[i]);
+
+                if (result == FAIL)
+                    return false;
+            }
+
+        int best = *std::max_element(rank.begin(), rank.end());
+        size_t kept = 0;
+
+        for (size_t i = 0; i < moves.size(); ++i)
+            if (rank[i] == best)
+                moves[kept++] = moves[i];
+
+        moves.resize(kept);
+        return true;
+    }
+}
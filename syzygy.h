@@ -0,0 +1,56 @@
+#ifndef SYZYGY_H
+#define SYZYGY_H
+
+#include "types.h"
+#include <string>
+#include <vector>
+
+class Position;
+
+// Probing of Syzygy endgame tablebases. Files are found by name in the
+// directories of the path (separated by ':' or, on Windows, ';') and are
+// memory mapped the first time a position with their material is probed.
+namespace Tablebases
+{
+    enum WDLScore
+    {
+        WDLLoss = -2,        // Loss
+        WDLBlessedLoss = -1, // Loss, but draw under the 50-move rule
+        WDLDraw = 0,         // Draw
+        WDLCursedWin = 1,    // Win, but draw under the 50-move rule
+        WDLWin = 2           // Win
+    };
+
+    enum ProbeState
+    {
+        FAIL = 0,              // Probe failed (missing file or material)
+        OK = 1,                // Probe succeeded
+        CHANGE_STM = -1,       // DTZ table is for the other side to move
+        ZEROING_BEST_MOVE = 2  // Best move is a capture or pawn move
+    };
+
+    // Pieces, kings included, of the largest table found. Zero when no
+    // tables are loaded, which turns every probe off.
+    extern int MaxCardinality;
+
+    // Below this remaining depth the search probes only tables with fewer
+    // pieces than the largest, whose files are more likely to be cached.
+    extern int ProbeDepth;
+
+    void init(const std::string& paths);
+
+    // Both leave *result at FAIL when the position cannot be probed, and
+    // require a position without castling rights. probe_dtz counts plies
+    // to the next capture or pawn move, ignoring the current 50-move count.
+    WDLScore probe_wdl(Position& pos, ProbeState* result);
+    int probe_dtz(Position& pos, ProbeState* result);
+
+    // Keeps only the moves that preserve the tablebase result. With DTZ
+    // tables winning moves are cut to those reaching a zeroing move
+    // soonest, and losing ones to those delaying it longest, so the search
+    // cannot shuffle away a win under the 50-move rule. Returns false,
+    // leaving moves untouched, if any probe fails.
+    bool root_probe(Position& pos, std::vector<Move>& moves, bool& usedDTZ);
+}
+
+#endif
@@ -0,0 +1,34 @@
+#include "timeman.h"
+#include <algorithm>
+
+TimeManager Time;
+
+// With a clock the remaining time, plus the increments still to come, is
+// spread over movestogo moves, or 40 in sudden death. Each of those moves
+// and a margin of two more lose the move overhead. The maximum allows five
+// times the optimum but never more than 80% of the clock. A movetime is
+// both optimum and maximum.
+void TimeManager::init(const Search::Limits& limits, Color us)
+{
+    startTime = std::chrono::steady_clock::now();
+    optimumTime = maximumTime = 0;
+
+    if (limits.movetime > 0)
+    {
+        optimumTime = maximumTime = std::max(1, limits.movetime - moveOverhead);
+        return;
+    }
+
+    if (limits.time[us] <= 0)
+        return;
+
+    int time = limits.time[us];
+    int inc = limits.inc[us];
+    int movesToGo = limits.movestogo > 0 ? std::min(limits.movestogo, 50) : 40;
+
+    int timeLeft = std::max(1, time + inc * (movesToGo - 1) - moveOverhead * (2 + movesToGo));
+
+    maximumTime = std::max(1, std::min(5 * timeLeft / movesToGo, time * 4 / 5 - moveOverhead));
+    optimumTime = std::min(timeLeft / movesToGo, maximumTime);
+    optimumTime = std::max(1, optimumTime);
+}
@@ -0,0 +1,35 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include "types.h"
+#include "search.h"
+#include <chrono>
+
+// Time budget for one search. The optimum is what an average move should
+// take and Search::start scales it by how settled the iterations look; the
+// maximum is a hard limit that is never passed. Both are 0 when the search
+// is not on the clock.
+class TimeManager
+{
+public:
+    void init(const Search::Limits& limits, Color us);
+
+    int optimum() const { return optimumTime; }
+    int maximum() const { return maximumTime; }
+    int elapsed() const
+    {
+        return int(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+    }
+
+    // Milliseconds lost per move between engine and GUI ("Move Overhead")
+    int moveOverhead = 30;
+
+private:
+    std::chrono::steady_clock::time_point startTime;
+    int optimumTime = 0;
+    int maximumTime = 0;
+};
+
+extern TimeManager Time;
+
+#endif
@@ -2,7 +2,23 @@
 #include "move.h"
 #include <cstring>
 #include <iostream>
+#include <fstream>
 #include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 TranspositionTable TT;
 
@@ -11,79 +27,562 @@ Move TTEntry::move() const
     return Move(move16);
 }
 
-TTEntry* TranspositionTable::probe(const Key key, bool& found) const
+void TranspositionTable::new_search()
+{
+    generation8 = shared ? uint8_t(shared->generation8.fetch_add(8) + 8) : uint8_t(generation8 + 8);
+}
+
+TTEntry* TranspositionTable::probe(const Key key, bool& found, Depth depth) const
 {
     TTEntry* const tte = first_entry(key);
-    const uint16_t key16 = uint16_t(key >> 48);
+    const TTKey keyBits = key_bits(key);
+
+    if (statsEnabled)
+        TTStats::add(stats.probes);
 
     for (int i = 0; i < ClusterSize; ++i)
-        if (!tte[i].key16 || tte[i].key16 == key16)
+        if (tte[i].key() == keyBits && tte[i].keyBits)
         {
             tte[i].genBound8 = uint8_t(generation8 | (tte[i].genBound8 & 0x3));
 
-            return found = (bool)tte[i].key16, &tte[i];
+            if (statsEnabled)
+                TTStats::add(stats.hits);
+
+            return found = true, &tte[i];
+        }
+
+    for (int i = 0; i < TTPolicy::DepthSlots; ++i)
+        if (!tte[i].keyBits)
+        {
+            if (statsEnabled)
+                TTStats::add(stats.emptyFills);
+
+            return found = false, &tte[i];
         }
 
+    if (TTPolicy::HasShallowSlot && depth <= TTPolicy::ShallowSlotDepth)
+    {
+        if (statsEnabled)
+            TTStats::add(stats.shallowFills);
+
+        return found = false, &tte[ClusterSize - 1];
+    }
+
     TTEntry* replace = tte;
-    for (int i = 1; i < ClusterSize; ++i)
+    for (int i = 1; i < TTPolicy::DepthSlots; ++i)
         if (replace->depth() - ((259 + generation8 - replace->genBound8) & 0xFC) * 2
     > tte[i].depth() - ((259 + generation8 - tte[i].genBound8) & 0xFC) * 2)
             replace = &tte[i];
 
+    if (statsEnabled)
+    {
+        TTStats::add(stats.replacements);
+        TTStats::add(stats.victimDepth[std::min(std::max(replace->depth() - DEPTH_NONE, 0), TTStats::DepthBuckets - 1)]);
+        TTStats::add(stats.victimAge[std::min(relative_age(replace->genBound8), TTStats::AgeBuckets - 1)]);
+    }
+
     return found = false, replace;
 }
 
+// Share of entries written during the current search, in permill. The sample
+// is spread over the whole table rather than taken from its start.
 int TranspositionTable::hashfull() const
 {
+    const size_t samples = std::min(clusterCount, size_t(1000));
     int cnt = 0;
-    for (int i = 0; i < 1000; ++i)
+
+    for (size_t i = 0; i < samples; ++i)
+    {
+        const Cluster& cluster = table[i * clusterCount / samples];
+        for (int j = 0; j < ClusterSize; ++j)
+            cnt += cluster.entry[j].keyBits && (cluster.entry[j].genBound8 & 0xF8) == generation8;
+    }
+
+    return int(cnt * 1000 / (samples * ClusterSize));
+}
+
+void TTStats::reset()
+{
+    for (Counter* c : { &probes, &hits, &emptyFills, &shallowFills, &replacements, &saves, &overwrites, &keptDeeper, &falseHits })
+        c->store(0, std::memory_order_relaxed);
+
+    for (Counter& c : victimDepth)
+        c.store(0, std::memory_order_relaxed);
+
+    for (Counter& c : victimAge)
+        c.store(0, std::memory_order_relaxed);
+}
+
+void TranspositionTable::print_stats(std::ostream& os) const
+{
+    const TTStats& st = stats;
+    const uint64_t misses = st.probes - st.hits;
+
+    os << "probes " << st.probes << " hits " << st.hits
+        << " hitrate " << (st.probes ? st.hits * 1000 / st.probes : 0) / 10.0 << "%" << std::endl;
+    os << "misses " << misses << ": empty " << st.emptyFills
+        << " shallow " << st.shallowFills << " replaced " << st.replacements << std::endl;
+    os << "saves " << st.saves << " overwrites " << st.overwrites
+        << " kept deeper " << st.keptDeeper << std::endl;
+    os << "false hits (tt move not legal) " << st.falseHits
+        << " (" << (st.hits ? st.falseHits * 1000000 / st.hits : 0) << " per million hits)" << std::endl;
+
+    os << "victim depth:";
+    for (int i = 0; i < TTStats::DepthBuckets; ++i)
+        if (st.victimDepth[i])
+            os << " " << i + DEPTH_NONE << (i == TTStats::DepthBuckets - 1 ? "+" : "") << ":" << st.victimDepth[i];
+    os << std::endl;
+
+    os << "victim age:";
+    for (int i = 0; i < TTStats::AgeBuckets; ++i)
+        if (st.victimAge[i])
+            os << " " << i << (i == TTStats::AgeBuckets - 1 ? "+" : "") << ":" << st.victimAge[i];
+    os << std::endl;
+
+    // Full scan of what the table currently holds.
+    uint64_t used = 0;
+    uint64_t depthHist[TTStats::DepthBuckets] = {};
+    uint64_t ageHist[TTStats::AgeBuckets] = {};
+
+    for (size_t i = 0; i < clusterCount; ++i)
         for (int j = 0; j < ClusterSize; ++j)
-            cnt += (table[i].entry[j].genBound8 & 0xFC) == generation8;
+        {
+            const TTEntry& e = table[i].entry[j];
+            if (!e.keyBits)
+                continue;
+
+            ++used;
+            ++depthHist[std::min(std::max(e.depth() - DEPTH_NONE, 0), TTStats::DepthBuckets - 1)];
+            ++ageHist[std::min(relative_age(e.genBound8), TTStats::AgeBuckets - 1)];
+        }
+
+    const uint64_t total = uint64_t(clusterCount) * ClusterSize;
+
+    os << "occupancy " << used << "/" << total
+        << " (" << (total ? used * 1000 / total : 0) / 10.0 << "%) hashfull " << hashfull() << std::endl;
 
-    return cnt / ClusterSize;
+    os << "entry depth:";
+    for (int i = 0; i < TTStats::DepthBuckets; ++i)
+        if (depthHist[i])
+            os << " " << i + DEPTH_NONE << (i == TTStats::DepthBuckets - 1 ? "+" : "") << ":" << depthHist[i];
+    os << std::endl;
+
+    os << "entry age:";
+    for (int i = 0; i < TTStats::AgeBuckets; ++i)
+        if (ageHist[i])
+            os << " " << i << (i == TTStats::AgeBuckets - 1 ? "+" : "") << ":" << ageHist[i];
+    os << std::endl;
 }
 
 void TranspositionTable::resize(size_t mbSize)
 {
-    aligned_ttmem_free(mem);
+    const size_t newCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+
+    if (newCount == clusterCount || shared)
+        return;
+
+    Cluster* const oldTable = table;
+    void* const oldMem = mem;
+    const size_t oldCount = clusterCount;
+
+    table = static_cast<Cluster*>(aligned_ttmem_alloc(newCount * sizeof(Cluster), mem));
 
-    clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+    // Not enough room for both tables at once: give up the old contents
+    // rather than the requested size.
+    bool keepOld = oldTable != nullptr;
+
+    if (!table && oldMem)
+    {
+        aligned_ttmem_free(oldMem);
+        table = static_cast<Cluster*>(aligned_ttmem_alloc(newCount * sizeof(Cluster), mem));
+        keepOld = false;
+    }
 
-    table = static_cast<Cluster*>(aligned_ttmem_alloc(clusterCount * sizeof(Cluster), mem));
     if (!table)
     {
         std::cerr << "Failed to allocate " << mbSize << "MB for transposition table." << std::endl;
         exit(EXIT_FAILURE);
     }
 
+    clusterCount = newCount;
     clear();
+
+    if (keepOld)
+    {
+        rehash(oldTable, oldCount);
+        aligned_ttmem_free(oldMem);
+    }
+}
+
+// Moves the entries of the previous table into the resized one. A cluster
+// only stores the low verification bits, so an entry's key is known just to
+// lie in the key range [first, last] that mapped to its old cluster. When that
+// whole range maps to a single new cluster (always the case when shrinking,
+// apart from clusters straddling a boundary) the entry is moved there;
+// otherwise it is dropped. Growing the table therefore starts it empty.
+void TranspositionTable::rehash(const Cluster* oldTable, size_t oldCount)
+{
+    if (clusterCount > oldCount)
+        return;
+
+    // 2^64 = q * oldCount + r, so the first key of old cluster i is
+    // ceil(i * 2^64 / oldCount) = i * q + ceil(i * r / oldCount).
+    uint64_t q = UINT64_MAX / oldCount;
+    uint64_t r = UINT64_MAX % oldCount + 1;
+    if (r == oldCount)
+        ++q, r = 0;
+
+    uint64_t base = 0, rem = 0;
+
+    for (size_t i = 0; i < oldCount; ++i)
+    {
+        const uint64_t first = base + (rem != 0);
+
+        rem += r;
+        base += q + (rem >= oldCount);
+        if (rem >= oldCount)
+            rem -= oldCount;
+
+        const uint64_t last = i + 1 == oldCount ? UINT64_MAX : base + (rem != 0) - 1;
+
+        const uint64_t j = mul_hi64(first, clusterCount);
+        if (j != mul_hi64(last, clusterCount) || cluster_empty(oldTable[i]))
+            continue;
+
+        for (int k = 0; k < ClusterSize; ++k)
+        {
+            const TTEntry& e = oldTable[i].entry[k];
+            if (!e.keyBits)
+                continue;
+
+            TTEntry* const tte = table[j].entry;
+            TTEntry* slot = nullptr;
+
+            for (int n = 0; n < TTPolicy::DepthSlots && !slot; ++n)
+                if (!tte[n].keyBits)
+                    slot = &tte[n];
+
+            if (!slot && TTPolicy::HasShallowSlot && e.depth() <= TTPolicy::ShallowSlotDepth)
+                slot = &tte[ClusterSize - 1];
+
+            if (!slot)
+            {
+                slot = tte;
+                for (int n = 1; n < TTPolicy::DepthSlots; ++n)
+                    if (tte[n].depth() < slot->depth())
+                        slot = &tte[n];
+
+                if (slot->depth() >= e.depth())
+                    continue;
+            }
+
+            *slot = e;
+        }
+    }
 }
 
+// A shared table is left alone: other processes are searching with it
 void TranspositionTable::clear()
+{
+    if (!shared)
+        wipe();
+}
+
+void TranspositionTable::wipe()
 {
     std::memset(table, 0, clusterCount * sizeof(Cluster));
 }
 
+bool TranspositionTable::save_to_file(const std::string& fileName, bool compact) const
+{
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    FileHeader header = {};
+    std::memcpy(header.magic, "ZTT1", 4);
+    header.version = FileVersion;
+    header.clusterCount = clusterCount;
+    header.clusterBytes = uint32_t(sizeof(Cluster));
+    header.generation8 = generation8;
+    header.compact = uint8_t(compact);
+    header.clusterSize = uint8_t(ClusterSize);
+    header.keyBytes = uint8_t(sizeof(TTKey));
+
+    if (compact)
+    {
+        for (size_t i = 0; i < clusterCount; ++i)
+            header.storedClusters += !cluster_empty(table[i]);
+    }
+    else
+        header.storedClusters = clusterCount;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if (compact)
+    {
+        // Sparse tables are common after short analyses, so only occupied
+        // clusters are written, each prefixed by its index.
+        for (size_t i = 0; i < clusterCount && out; ++i)
+            if (!cluster_empty(table[i]))
+            {
+                uint64_t idx = i;
+                out.write(reinterpret_cast<const char*>(&idx), sizeof(idx));
+                out.write(reinterpret_cast<const char*>(&table[i]), sizeof(Cluster));
+            }
+    }
+    else
+    {
+        constexpr size_t chunk = 64 * 1024 * 1024 / sizeof(Cluster);
+        for (size_t i = 0; i < clusterCount && out; i += chunk)
+            out.write(reinterpret_cast<const char*>(&table[i]), std::min(chunk, clusterCount - i) * sizeof(Cluster));
+    }
+
+    return bool(out);
+}
+
+bool TranspositionTable::load_from_file(const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in)
+        return false;
+
+    FileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, "ZTT1", 4)
+        || header.version != FileVersion
+        || header.clusterBytes != sizeof(Cluster)
+        || header.clusterSize != ClusterSize
+        || header.keyBytes != sizeof(TTKey)
+        || !header.clusterCount
+        || header.storedClusters > header.clusterCount)
+        return false;
+
+    if (header.clusterCount != clusterCount)
+    {
+        if (shared)
+            return false;
+
+        size_t mbSize = size_t(header.clusterCount * sizeof(Cluster) / (1024 * 1024));
+        resize(std::max(mbSize, size_t(1)));
+        if (clusterCount != header.clusterCount)
+            return false;
+    }
+
+    wipe();
+
+    if (header.compact)
+    {
+        for (uint64_t n = 0; n < header.storedClusters; ++n)
+        {
+            uint64_t idx;
+            if (!in.read(reinterpret_cast<char*>(&idx), sizeof(idx)) || idx >= clusterCount
+                || !in.read(reinterpret_cast<char*>(&table[idx]), sizeof(Cluster)))
+            {
+                wipe();
+                return false;
+            }
+        }
+    }
+    else
+    {
+        constexpr size_t chunk = 64 * 1024 * 1024 / sizeof(Cluster);
+        for (size_t i = 0; i < clusterCount; i += chunk)
+            if (!in.read(reinterpret_cast<char*>(&table[i]), std::min(chunk, clusterCount - i) * sizeof(Cluster)))
+            {
+                wipe();
+                return false;
+            }
+    }
+
+    generation8 = header.generation8;
+    return true;
+}
+
+bool TranspositionTable::cluster_empty(const Cluster& cluster)
+{
+    for (int i = 0; i < ClusterSize; ++i)
+        if (cluster.entry[i].keyBits)
+            return false;
+
+    return true;
+}
+
 void TTEntry::save(Key k, Value v, bool ttPv, Bound b, Depth d, Move m, Value ev)
 {
-    if (m != MOVE_NONE || (k >> 48) != key16)
+    const TTKey kb = TranspositionTable::key_bits(k);
+    const TTKey stored = key();
+
+    if (TT.statsEnabled)
+    {
+        TTStats::add(TT.stats.saves);
+        TTStats::add(TT.stats.overwrites, kb != stored && keyBits);
+        TTStats::add(TT.stats.keptDeeper, kb == stored && d + 2 <= depth8 - 4);
+    }
+
+    if (m != MOVE_NONE || kb != stored)
         move16 = uint16_t(m);
 
-    if ((k >> 48) != key16 || d + 2 > depth8 - 4)
+    if (kb != stored || d + 2 > depth8 - 4)
     {
-        key16 = uint16_t(k >> 48);
         value16 = int16_t(v);
         eval16 = int16_t(ev);
         genBound8 = uint8_t(TT.generation8 | uint8_t(ttPv) << 2 | b);
         depth8 = int8_t(d);
     }
+
+    keyBits = TTKey(kb ^ check());
+}
+
+bool TranspositionTable::attach_shared(const std::string& name, size_t mbSize)
+{
+    detach_shared();
+
+    size_t count = mbSize * 1024 * 1024 / sizeof(Cluster);
+    size_t size = sizeof(SharedHeader) + count * sizeof(Cluster);
+    bool created = false;
+    void* base = nullptr;
+
+#ifdef _WIN32
+    const std::string objectName = "Local\\zorn_tt_" + name;
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        DWORD(uint64_t(size) >> 32), DWORD(size), objectName.c_str());
+    if (!mapping)
+        return false;
+
+    created = GetLastError() != ERROR_ALREADY_EXISTS;
+    base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!base)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(base, &info, sizeof(info));
+    size = info.RegionSize;
+    sharedHandle = mapping;
+#else
+    const std::string objectName = "/zorn_tt_" + name;
+    int fd = shm_open(objectName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if (fd >= 0)
+    {
+        created = true;
+        if (ftruncate(fd, off_t(size)) != 0)
+        {
+            close(fd);
+            shm_unlink(objectName.c_str());
+            return false;
+        }
+    }
+    else
+    {
+        fd = shm_open(objectName.c_str(), O_RDWR, 0600);
+        if (fd < 0)
+            return false;
+
+        // The creator may not have sized the segment yet.
+        struct stat st;
+        for (int i = 0; i < 100 && (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SharedHeader)); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SharedHeader))
+        {
+            close(fd);
+            return false;
+        }
+        size = size_t(st.st_size);
+    }
+
+    base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+#endif
+
+    SharedHeader* header = static_cast<SharedHeader*>(base);
+
+    if (created)
+    {
+        std::memcpy(header->magic, "ZTTS", 4);
+        header->version = FileVersion;
+        header->clusterCount = count;
+        header->clusterBytes = uint32_t(sizeof(Cluster));
+        header->clusterSize = uint8_t(ClusterSize);
+        header->keyBytes = uint8_t(sizeof(TTKey));
+        header->generation8.store(generation8);
+        header->ready.store(1, std::memory_order_release);
+    }
+    else
+    {
+        for (int i = 0; i < 100 && !header->ready.load(std::memory_order_acquire); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        if (!header->ready.load(std::memory_order_acquire)
+            || std::memcmp(header->magic, "ZTTS", 4)
+            || header->version != FileVersion
+            || header->clusterBytes != sizeof(Cluster)
+            || header->clusterSize != ClusterSize
+            || header->keyBytes != sizeof(TTKey)
+            || sizeof(SharedHeader) + header->clusterCount * sizeof(Cluster) > size)
+        {
+            unmap_shared(base, size, sharedHandle);
+            sharedHandle = nullptr;
+            return false;
+        }
+    }
+
+    aligned_ttmem_free(mem);
+    mem = nullptr;
+
+    shared = header;
+    sharedSize = size;
+    clusterCount = size_t(header->clusterCount);
+    table = reinterpret_cast<Cluster*>(header + 1);
+    generation8 = header->generation8.load();
+
+    return true;
+}
+
+// Unmaps the segment but leaves it in place for the other processes. The
+// segment itself lives until it is removed from the system (on Linux, by
+// deleting /dev/shm/zorn_tt_<name>) or the last handle closes on Windows.
+void TranspositionTable::detach_shared()
+{
+    if (!shared)
+        return;
+
+    unmap_shared(shared, sharedSize, sharedHandle);
+
+    shared = nullptr;
+    sharedSize = 0;
+    sharedHandle = nullptr;
+    table = nullptr;
+    clusterCount = 0;
+}
+
+#ifdef _WIN32
+void TranspositionTable::unmap_shared(void* base, size_t, void* handle)
+{
+    UnmapViewOfFile(base);
+    CloseHandle(static_cast<HANDLE>(handle));
 }
+#else
+void TranspositionTable::unmap_shared(void* base, size_t size, void*)
+{
+    munmap(base, size);
+}
+#endif
 
 void* TranspositionTable::aligned_ttmem_alloc(size_t allocSize, void*& mem)
 {
     constexpr size_t alignment = 2 * 1024 * 1024;
     size_t size = allocSize + alignment - 1;
     mem = std::malloc(size);
+    if (!mem)
+        return nullptr;
+
     void* ret = reinterpret_cast<void*>((uintptr_t(mem) + alignment - 1) & ~uintptr_t(alignment - 1));
     return ret;
 }
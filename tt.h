@@ -2,6 +2,30 @@
 #define TT_H
 
 #include "types.h"
+#include <string>
+#include <atomic>
+#include <iosfwd>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// Upper 64 bits of the 128-bit product, used to map a key onto [0, n) for
+// any n without requiring a power-of-two table size.
+inline uint64_t mul_hi64(uint64_t a, uint64_t b)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    return __umulh(a, b);
+#elif defined(__SIZEOF_INT128__)
+    return uint64_t((unsigned __int128)a * b >> 64);
+#else
+    uint64_t aLo = uint32_t(a), aHi = a >> 32;
+    uint64_t bLo = uint32_t(b), bHi = b >> 32;
+    uint64_t mid = aHi * bLo + (aLo * bLo >> 32);
+    uint64_t mid2 = aLo * bHi + uint32_t(mid);
+    return aHi * bHi + (mid >> 32) + (mid2 >> 32);
+#endif
+}
 
 enum Bound : uint8_t
 {
@@ -11,6 +35,38 @@ enum Bound : uint8_t
     BOUND_EXACT = BOUND_UPPER | BOUND_LOWER
 };
 
+// Cluster geometry is fixed at compile time. KeyT is the verification key
+// stored per entry, Entries how many entries share one cluster of Bytes bytes.
+// With ShallowSlot the last entry of each cluster is an always-replace slot
+// that takes entries of depth <= ShallowDepth, keeping them from evicting
+// deeper results in the depth-preferred entries.
+template<typename KeyT, int Entries, int Bytes, bool ShallowSlot = false, int ShallowDepth = 1>
+struct TTGeometry
+{
+    typedef KeyT KeyType;
+
+    static constexpr int ClusterSize = Entries;
+    static constexpr int ClusterBytes = Bytes;
+    static constexpr bool HasShallowSlot = ShallowSlot;
+    static constexpr int ShallowSlotDepth = ShallowDepth;
+    static constexpr int DepthSlots = ShallowSlot ? Entries - 1 : Entries;
+};
+
+struct TTCluster32x3 : TTGeometry<uint16_t, 3, 32> { static const char* name() { return "32B/3x16"; } };
+struct TTCluster64x4 : TTGeometry<uint16_t, 4, 64> { static const char* name() { return "64B/4x16"; } };
+struct TTCluster64x5 : TTGeometry<uint16_t, 5, 64> { static const char* name() { return "64B/5x16"; } };
+struct TTCluster64x4Key32 : TTGeometry<uint32_t, 4, 64> { static const char* name() { return "64B/4x32"; } };
+struct TTCluster64x5Key32 : TTGeometry<uint32_t, 5, 64> { static const char* name() { return "64B/5x32"; } };
+struct TTCluster32x3Shallow : TTGeometry<uint16_t, 3, 32, true> { static const char* name() { return "32B/3x16+shallow"; } };
+struct TTCluster64x5Shallow : TTGeometry<uint16_t, 5, 64, true> { static const char* name() { return "64B/5x16+shallow"; } };
+
+#ifndef ZORN_TT_POLICY
+#define ZORN_TT_POLICY TTCluster32x3
+#endif
+
+typedef ZORN_TT_POLICY TTPolicy;
+typedef TTPolicy::KeyType TTKey;
+
 struct TTEntry
 {
     Move move() const;
@@ -24,7 +80,24 @@ struct TTEntry
 private:
     friend class TranspositionTable;
 
-    uint16_t key16;
+    // The stored key is XORed with a hash of the payload, so an entry torn by
+    // a concurrent writer (another thread or, with a shared table, another
+    // process) fails verification instead of returning mixed data. The
+    // generation bits are left out because probe() refreshes them in place.
+    TTKey check() const
+    {
+        uint64_t d = uint64_t(move16)
+            | uint64_t(uint16_t(value16)) << 16
+            | uint64_t(uint16_t(eval16)) << 32
+            | uint64_t(uint8_t(depth8)) << 48
+            | uint64_t(genBound8 & 0x3) << 56;
+
+        return TTKey((d * 0x9E3779B97F4A7C15ULL) >> (64 - 8 * sizeof(TTKey)));
+    }
+
+    TTKey key() const { return TTKey(keyBits ^ check()); }
+
+    TTKey keyBits;
     uint16_t move16;
     int16_t value16;
     int16_t eval16;
@@ -32,21 +105,69 @@ private:
     int8_t depth8;
 };
 
+// Counters kept by probe() and TTEntry::save() while stats are enabled.
+// Histograms are indexed by depth - DEPTH_NONE and by age in generations,
+// the last bucket collecting everything above. Every search thread counts
+// into them, so they are atomics added to with relaxed order.
+struct TTStats
+{
+    static constexpr int DepthBuckets = 32;
+    static constexpr int AgeBuckets = 32;
+
+    typedef std::atomic<uint64_t> Counter;
+
+    TTStats() { reset(); }
+    void reset();
+    static void add(Counter& c, uint64_t n = 1) { c.fetch_add(n, std::memory_order_relaxed); }
+
+    Counter probes;
+    Counter hits;
+    Counter emptyFills;
+    Counter shallowFills;
+    Counter replacements;
+    Counter saves;
+    Counter overwrites;
+    Counter keptDeeper;
+    Counter falseHits;
+    Counter victimDepth[DepthBuckets];
+    Counter victimAge[AgeBuckets];
+};
+
 class TranspositionTable
 {
 public:
-    TranspositionTable() : clusterCount(0), table(nullptr), mem(nullptr), generation8(8) {}
-    ~TranspositionTable() { aligned_ttmem_free(mem); }
+    TranspositionTable() : clusterCount(0), table(nullptr), mem(nullptr), generation8(8), statsEnabled(false),
+        shared(nullptr), sharedSize(0), sharedHandle(nullptr) {}
+    ~TranspositionTable() { detach_shared(); aligned_ttmem_free(mem); }
 
-    void new_search() { generation8 += 8; }
-    TTEntry* probe(const Key key, bool& found) const;
+    void new_search();
+    TTEntry* probe(const Key key, bool& found, Depth depth = DEPTH_MAX) const;
     int hashfull() const;
     void resize(size_t mbSize);
-    void clear();
+    void clear(); // A no-op while attached to a shared table
+
+    size_t size_mb() const { return clusterCount * sizeof(Cluster) / (1024 * 1024); }
+    void enable_stats(bool on) { statsEnabled = on; }
+    bool stats_enabled() const { return statsEnabled; }
+    const TTStats& statistics() const { return stats; }
+    void reset_stats() const { stats.reset(); }
+    void record_false_hit() const { if (statsEnabled) TTStats::add(stats.falseHits); }
+    void print_stats(std::ostream& os) const;
+
+    // The index comes from the high bits of the key, so verification uses the
+    // low bits to stay independent of it.
+    static TTKey key_bits(Key key) { return TTKey(key); }
+
+    bool save_to_file(const std::string& fileName, bool compact) const;
+    bool load_from_file(const std::string& fileName);
+
+    bool attach_shared(const std::string& name, size_t mbSize);
+    void detach_shared();
+    bool is_shared() const { return shared != nullptr; }
 
     TTEntry* first_entry(const Key key) const
     {
-        return &table[(size_t)key & (clusterCount - 1)].entry[0];
+        return &table[mul_hi64(key, clusterCount)].entry[0];
     }
 
 private:
@@ -54,19 +175,63 @@ private:
 
     size_t clusterCount;
 
-    static constexpr int ClusterSize = 3;
+    static constexpr int ClusterSize = TTPolicy::ClusterSize;
 
-    struct Cluster
+    struct alignas(TTPolicy::ClusterBytes) Cluster
     {
         TTEntry entry[ClusterSize];
-        int8_t padding[2];
     };
 
     Cluster* table;
     void* mem;
     uint8_t generation8;
+    bool statsEnabled;
+    mutable TTStats stats;
+
+    static_assert(sizeof(Cluster) == TTPolicy::ClusterBytes, "Cluster size incorrect");
+
+    // On-disk layout written by savehash. Version must be bumped whenever the
+    // key scheme or entry packing changes, otherwise stale files would load.
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t clusterCount;
+        uint64_t storedClusters;
+        uint32_t clusterBytes;
+        uint8_t generation8;
+        uint8_t compact;
+        uint8_t clusterSize;
+        uint8_t keyBytes;
+    };
+
+    static constexpr uint32_t FileVersion = 4;
+
+    // Start of a named shared-memory segment; the clusters follow it. The
+    // first process to open the name creates and sizes the segment, later
+    // ones adopt its geometry once ready is set.
+    struct alignas(64) SharedHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t clusterCount;
+        uint32_t clusterBytes;
+        uint8_t clusterSize;
+        uint8_t keyBytes;
+        std::atomic<uint8_t> generation8;
+        std::atomic<uint32_t> ready;
+    };
+
+    SharedHeader* shared;
+    size_t sharedSize;
+    void* sharedHandle;
+
+    static bool cluster_empty(const Cluster& cluster);
+    int relative_age(uint8_t genBound8) const { return uint8_t(generation8 - (genBound8 & 0xF8)) >> 3; }
+    void rehash(const Cluster* oldTable, size_t oldCount);
+    void wipe(); // clear() even when shared
 
-    static_assert(sizeof(Cluster) == 32, "Cluster size incorrect");
+    static void unmap_shared(void* base, size_t size, void* handle);
 
     void* aligned_ttmem_alloc(size_t allocSize, void*& mem);
     void aligned_ttmem_free(void* mem);
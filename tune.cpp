@@ -0,0 +1,528 @@
+#include "tune.h"
+#include "eval.h"
+#include "eval_features.h"
+#include "board.h"
+#include "pawns.h"
+#include "material.h"
+#include "search.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace Tune
+{
+    namespace
+    {
+        enum Phase { MG, EG, BOTH };
+
+        // A weight table of eval_params.cpp. Entries first..last are tuned,
+        // the others are kept as they are.
+        struct Table
+        {
+            const char* name;
+            const Value* values;
+            int size;
+            Phase phase;
+            int first, last;
+            int offset;
+        };
+
+        // Table order; piece-square tables are MG then EG for each piece.
+        enum { PIECE_VALUES_MG, PIECE_VALUES_EG, PIECE_SQUARE, MOBILITY = PIECE_SQUARE + 12, HANGING, TABLE_NB };
+
+        struct Coefficient
+        {
+            uint16_t index;
+            int16_t count;
+        };
+
+        // The evaluation of a sample is fixed + sum(count * weight * phase
+        // weight), where the MG phase weight is phase / 24 and the EG one also
+        // carries the scale factor, frozen at the starting weights.
+        struct Sample
+        {
+            uint32_t first;
+            uint16_t count;
+            float mgWeight;
+            float egWeight;
+            float fixed;
+            float result;
+        };
+
+        vector<Table> tables;
+        vector<double> startWeights;
+        vector<Phase> weightPhase;
+        vector<bool> tuned;
+        vector<Coefficient> coefficients;
+        vector<Sample> samples;
+
+        void add_table(const char* name, const Value* values, int size, Phase phase, int first, int last)
+        {
+            int offset = int(weightPhase.size());
+
+            tables.push_back({ name, values, size, phase, first, last, offset });
+
+            for (int i = 0; i < size; ++i)
+            {
+                startWeights.push_back(values[i]);
+                weightPhase.push_back(phase);
+                tuned.push_back(i >= first && i <= last);
+            }
+        }
+
+        void init_tables()
+        {
+            using namespace Eval;
+
+            const char* mgNames[] = { "PawnTableMG", "KnightTableMG", "BishopTableMG", "RookTableMG", "QueenTableMG", "KingTableMG" };
+            const char* egNames[] = { "PawnTableEG", "KnightTableEG", "BishopTableEG", "RookTableEG", "QueenTableEG", "KingTableEG" };
+            const Value* mg[] = { PawnTableMG, KnightTableMG, BishopTableMG, RookTableMG, QueenTableMG, KingTableMG };
+            const Value* eg[] = { PawnTableEG, KnightTableEG, BishopTableEG, RookTableEG, QueenTableEG, KingTableEG };
+
+            tables.clear();
+            startWeights.clear();
+            weightPhase.clear();
+            tuned.clear();
+
+            add_table("PieceValuesMG", PieceValuesMG, PIECE_TYPE_NB, MG, PAWN, QUEEN);
+            add_table("PieceValuesEG", PieceValuesEG, PIECE_TYPE_NB, EG, PAWN, QUEEN);
+
+            for (int i = 0; i < 6; ++i)
+            {
+                add_table(mgNames[i], mg[i], SQUARE_NB, MG, 0, SQUARE_NB - 1);
+                add_table(egNames[i], eg[i], SQUARE_NB, EG, 0, SQUARE_NB - 1);
+            }
+
+            add_table("MobilityWeight", MobilityWeight, PIECE_TYPE_NB, BOTH, KNIGHT, QUEEN);
+            add_table("HangingPenalty", HangingPenalty, PIECE_TYPE_NB, BOTH, PAWN, QUEEN);
+        }
+
+        int weight_index(int table, int i)
+        {
+            return tables[table].offset + i;
+        }
+
+        // Result from White's point of view, or a negative number if the
+        // line carries none.
+        float parse_result(const string& s)
+        {
+            if (s.find("1/2-1/2") != string::npos) return 0.5f;
+            if (s.find("1-0") != string::npos) return 1.0f;
+            if (s.find("0-1") != string::npos) return 0.0f;
+
+            size_t open = s.find('[');
+            if (open != string::npos)
+                return float(atof(s.c_str() + open + 1));
+
+            return -1.0f;
+        }
+
+        // Reduces a position to its coefficients. Returns false for
+        // positions the classical evaluation does not score, i.e. known
+        // endgames.
+        bool extract(const Position& pos, vector<int>& counts, vector<int>& touched,
+            vector<Coefficient>& out, Sample& sample)
+        {
+            Material::Entry* me = Material::probe(pos);
+            if (me->specialized_eval_exists())
+                return false;
+
+            Pawns::Entry* pe = Pawns::probe(pos);
+
+            auto add = [&](int index, int n) {
+                if (!n)
+                    return;
+                if (!counts[index])
+                    touched.push_back(index);
+                counts[index] += n;
+            };
+
+            Value kingShield = pe->king_shield<WHITE>(pos, pos.square<KING>(WHITE))
+                - pe->king_shield<BLACK>(pos, pos.square<KING>(BLACK));
+
+            Score fixed = me->imbalance() + pe->score() + make_score(kingShield, kingShield)
+                + (pos.side_to_move() == WHITE ? Eval::Tempo : -Eval::Tempo);
+
+            for (Bitboard b = pos.pieces(); b; )
+            {
+                Square s = pop_lsb(b);
+                Piece pc = pos.piece_on(s);
+                PieceType pt = type_of(pc);
+                int sign = color_of(pc) == WHITE ? 1 : -1;
+                Square rs = color_of(pc) == WHITE ? s : Square(s ^ 56);
+
+                if (pt != KING)
+                {
+                    add(weight_index(PIECE_VALUES_MG, pt), sign);
+                    add(weight_index(PIECE_VALUES_EG, pt), sign);
+                }
+
+                add(weight_index(PIECE_SQUARE + 2 * (pt - 1), rs), sign);
+                add(weight_index(PIECE_SQUARE + 2 * (pt - 1) + 1, rs), sign);
+                fixed += sign * make_score(Eval::squareBonus(pt, rs), 0);
+            }
+
+            Eval::EvalInfo ei;
+            Eval::initEvalInfo(pos, pe, ei);
+
+            for (Color c = WHITE; c <= BLACK; ++c)
+            {
+                int sign = c == WHITE ? 1 : -1;
+
+                for (PieceType pt = KNIGHT; pt <= QUEEN; ++pt)
+                    for (Bitboard b = pos.pieces(c, pt); b; )
+                        add(weight_index(MOBILITY, pt),
+                            sign * popcount(attacks_bb(pt, pop_lsb(b), pos.pieces()) & ~pos.pieces(c)));
+
+                Bitboard hanging = pos.pieces(c) & ei.attackedBy[~c][NO_PIECE_TYPE] & ~ei.attackedBy[c][NO_PIECE_TYPE];
+
+                for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+                    add(weight_index(HANGING, pt), -sign * popcount(hanging & pos.pieces(c, pt)));
+            }
+
+            // The scale factor depends on who is ahead in the endgame, so it is
+            // taken from the starting weights and kept fixed.
+            double mg = mg_value(fixed), eg = eg_value(fixed);
+
+            sample.first = uint32_t(out.size());
+            sample.count = 0;
+
+            for (int index : touched)
+            {
+                if (counts[index])
+                {
+                    double w = startWeights[index];
+
+                    if (weightPhase[index] != EG) mg += counts[index] * w;
+                    if (weightPhase[index] != MG) eg += counts[index] * w;
+
+                    out.push_back({ uint16_t(index), int16_t(counts[index]) });
+                    ++sample.count;
+                }
+                counts[index] = 0;
+            }
+            touched.clear();
+
+            int phase = me->game_phase();
+            ScaleFactor sf = me->scale_factor(pos, eg > 0 ? WHITE : BLACK);
+
+            sample.mgWeight = float(phase / 24.0);
+            sample.egWeight = float(sf / double(SCALE_FACTOR_NORMAL) * (24 - phase) / 24.0);
+            sample.fixed = float(mg_value(fixed) * sample.mgWeight + eg_value(fixed) * sample.egWeight);
+
+            return true;
+        }
+
+        // Loads the dataset, splitting the parsing across threads. Each
+        // worker has its own Thread so pawn and material probes do not share
+        // tables.
+        bool load(const string& fileName, int threadCount)
+        {
+            ifstream file(fileName);
+            if (!file)
+            {
+                cout << "info string Cannot open " << fileName << endl;
+                return false;
+            }
+
+            vector<string> lines;
+            for (string line; getline(file, line); )
+                if (!line.empty())
+                    lines.push_back(line);
+
+            struct Part
+            {
+                vector<Coefficient> coefficients;
+                vector<Sample> samples;
+                size_t skipped = 0;
+            };
+
+            vector<Part> parts(threadCount);
+            vector<thread> workers;
+
+            for (int t = 0; t < threadCount; ++t)
+                workers.emplace_back([&, t]() {
+                    unique_ptr<Thread> th(new Thread(t + 1));
+                    vector<int> counts(weightPhase.size(), 0);
+                    vector<int> touched;
+                    Part& part = parts[t];
+
+                    for (size_t i = t; i < lines.size(); i += threadCount)
+                    {
+                        istringstream ss(lines[i]);
+                        string fields[4];
+                        float result;
+
+                        if (!(ss >> fields[0] >> fields[1] >> fields[2] >> fields[3])
+                            || (result = parse_result(lines[i].substr(size_t(ss.tellg())))) < 0)
+                        {
+                            ++part.skipped;
+                            continue;
+                        }
+
+                        Position pos;
+                        StateInfo st;
+                        pos.set(fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + " 0 1", false, &st, th.get());
+
+                        Sample sample;
+                        sample.result = result;
+
+                        if (extract(pos, counts, touched, part.coefficients, sample))
+                            part.samples.push_back(sample);
+                        else
+                            ++part.skipped;
+                    }
+                });
+
+            for (thread& w : workers)
+                w.join();
+
+            size_t skipped = 0;
+            coefficients.clear();
+            samples.clear();
+
+            for (Part& part : parts)
+            {
+                uint32_t base = uint32_t(coefficients.size());
+                for (Sample s : part.samples)
+                {
+                    s.first += base;
+                    samples.push_back(s);
+                }
+                coefficients.insert(coefficients.end(), part.coefficients.begin(), part.coefficients.end());
+                skipped += part.skipped;
+            }
+
+            cout << "info string Loaded " << samples.size() << " positions, skipped " << skipped
+                << ", " << weightPhase.size() << " weights" << endl;
+
+            return !samples.empty();
+        }
+
+        double sample_eval(const Sample& s, const vector<double>& w)
+        {
+            double v = s.fixed;
+
+            for (uint32_t i = s.first; i < s.first + s.count; ++i)
+            {
+                const Coefficient& c = coefficients[i];
+                double pw = weightPhase[c.index] == MG ? s.mgWeight
+                    : weightPhase[c.index] == EG ? s.egWeight : s.mgWeight + s.egWeight;
+
+                v += c.count * w[c.index] * pw;
+            }
+
+            return v;
+        }
+
+        // Mean squared error of sigmoid(k * eval) against the results and,
+        // if grad is given, its gradient with respect to the weights.
+        double error(const vector<double>& w, double k, vector<double>* grad, int threadCount)
+        {
+            vector<double> errors(threadCount, 0.0);
+            vector<vector<double>> grads(grad ? threadCount : 0, vector<double>(w.size(), 0.0));
+            vector<thread> workers;
+
+            for (int t = 0; t < threadCount; ++t)
+                workers.emplace_back([&, t]() {
+                    size_t begin = samples.size() * t / threadCount;
+                    size_t end = samples.size() * (t + 1) / threadCount;
+                    double e = 0.0;
+
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        const Sample& s = samples[i];
+                        double sig = 1.0 / (1.0 + exp(-k * sample_eval(s, w)));
+                        double diff = s.result - sig;
+
+                        e += diff * diff;
+
+                        if (grad)
+                        {
+                            double g = -2.0 * diff * sig * (1.0 - sig) * k;
+                            vector<double>& gt = grads[t];
+
+                            for (uint32_t j = s.first; j < s.first + s.count; ++j)
+                            {
+                                const Coefficient& c = coefficients[j];
+                                double pw = weightPhase[c.index] == MG ? s.mgWeight
+                                    : weightPhase[c.index] == EG ? s.egWeight : s.mgWeight + s.egWeight;
+
+                                gt[c.index] += g * c.count * pw;
+                            }
+                        }
+                    }
+
+                    errors[t] = e;
+                });
+
+            for (thread& th : workers)
+                th.join();
+
+            double n = double(samples.size());
+
+            if (grad)
+            {
+                grad->assign(w.size(), 0.0);
+                for (const vector<double>& gt : grads)
+                    for (size_t i = 0; i < w.size(); ++i)
+                        (*grad)[i] += gt[i] / n;
+            }
+
+            double total = 0.0;
+            for (double e : errors)
+                total += e;
+
+            return total / n;
+        }
+
+        // Sigmoid scale that best fits the starting weights, found by golden
+        // section search.
+        double fit_k(const vector<double>& w, int threadCount)
+        {
+            const double phi = (sqrt(5.0) - 1) / 2;
+            double a = 0.0001, b = 0.05;
+
+            for (int i = 0; i < 30; ++i)
+            {
+                double c = b - phi * (b - a), d = a + phi * (b - a);
+
+                if (error(w, c, nullptr, threadCount) < error(w, d, nullptr, threadCount))
+                    b = d;
+                else
+                    a = c;
+            }
+
+            return (a + b) / 2;
+        }
+
+        void write_table(ostream& os, const Table& t, const vector<double>& w)
+        {
+            auto value = [&](int i) { return int(lround(w[t.offset + i])); };
+
+            if (t.size == PIECE_TYPE_NB)
+            {
+                os << "    const Value " << t.name << "[PIECE_TYPE_NB] = {";
+                for (int i = 0; i < t.size; ++i)
+                    os << (i ? ", " : " ") << value(i);
+                os << " };\n";
+                return;
+            }
+
+            os << "    const Value " << t.name << "[SQUARE_NB] =\n    {\n";
+            for (int r = 0; r < 8; ++r)
+            {
+                os << "      ";
+                for (int f = 0; f < 8; ++f)
+                {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "%3d", value(8 * r + f));
+                    os << (f ? ", " : "") << buf;
+                }
+                os << (r < 7 ? ",\n" : "\n");
+            }
+            os << "    };\n";
+        }
+
+        bool write_params(const string& fileName, const vector<double>& w)
+        {
+            ofstream os(fileName);
+            if (!os)
+                return false;
+
+            os << "#include \"eval.h\"\n"
+                << "#include \"eval_features.h\"\n"
+                << "\n"
+                << "// Evaluation weights. \"tune\" writes a replacement for this file in the same\n"
+                << "// layout, so hand edits should keep to it.\n"
+                << "namespace Eval\n"
+                << "{\n";
+
+            write_table(os, tables[PIECE_VALUES_MG], w);
+            write_table(os, tables[PIECE_VALUES_EG], w);
+            os << "\n";
+
+            for (int i = PIECE_SQUARE; i < MOBILITY; ++i)
+            {
+                write_table(os, tables[i], w);
+                os << "\n";
+            }
+
+            write_table(os, tables[MOBILITY], w);
+            write_table(os, tables[HANGING], w);
+            os << "}\n";
+
+            return bool(os);
+        }
+    }
+
+    void run(const Options& options)
+    {
+        typedef chrono::steady_clock Clock;
+        auto start = Clock::now();
+        auto seconds = [&]() { return chrono::duration_cast<chrono::milliseconds>(Clock::now() - start).count() / 1000.0; };
+
+        int threadCount = options.threads > 0 ? options.threads : max(1, int(thread::hardware_concurrency()));
+
+        init_tables();
+
+        if (!load(options.dataFile, threadCount))
+            return;
+
+        vector<double> w = startWeights;
+
+        double k = fit_k(w, threadCount);
+        double e = error(w, k, nullptr, threadCount);
+
+        cout << "info string threads " << threadCount << " k " << k << " start error " << e
+            << " (" << seconds() << "s)" << endl;
+
+        // Adam with the usual decay rates; the learning rate is in
+        // centipawns per step.
+        const double beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+        vector<double> m(w.size(), 0.0), v(w.size(), 0.0), grad;
+
+        for (int epoch = 1; epoch <= options.epochs; ++epoch)
+        {
+            e = error(w, k, &grad, threadCount);
+
+            for (size_t i = 0; i < w.size(); ++i)
+            {
+                if (!tuned[i])
+                    continue;
+
+                m[i] = beta1 * m[i] + (1 - beta1) * grad[i];
+                v[i] = beta2 * v[i] + (1 - beta2) * grad[i] * grad[i];
+
+                double mHat = m[i] / (1 - pow(beta1, epoch));
+                double vHat = v[i] / (1 - pow(beta2, epoch));
+
+                w[i] -= options.learningRate * mHat / (sqrt(vHat) + eps);
+            }
+
+            if (epoch % 50 == 0 || epoch == options.epochs)
+                cout << "info string epoch " << epoch << " error " << e << " (" << seconds() << "s)" << endl;
+        }
+
+        if (options.epochs > 0)
+            cout << "info string final error " << error(w, k, nullptr, threadCount) << endl;
+
+        if (write_params(options.outFile, w))
+            cout << "info string Weights written to " << options.outFile << endl;
+        else
+            cout << "info string Failed to write " << options.outFile << endl;
+
+        coefficients.clear();
+        coefficients.shrink_to_fit();
+        samples.clear();
+        samples.shrink_to_fit();
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <string>
+
+// Texel tuning of the classical evaluation weights in eval_params.cpp.
+//
+// The dataset is one position per line: a FEN (at least the first four
+// fields) followed somewhere by the game result, as "1-0", "0-1",
+// "1/2-1/2" or a bracketed White score such as [0.5]. Every tuned weight
+// enters the evaluation linearly, so each position is reduced once to
+// sparse per-weight coefficients plus a fixed part. Training is then
+// full-batch Adam on the logistic loss, with positions split across
+// threads.
+namespace Tune
+{
+    struct Options
+    {
+        std::string dataFile;
+        std::string outFile = "eval_params_tuned.cpp";
+        int epochs = 500;
+        int threads = 0;
+        double learningRate = 1.0;
+    };
+
+    void run(const Options& options);
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <cassert>
 #include <cstdlib>
+#include <vector>
 
 typedef uint64_t U64;
 typedef uint32_t U32;
@@ -40,9 +41,9 @@ enum Piece : U8
 {
     NO_PIECE = 0,
     W_PAWN = 1, W_KNIGHT = 2, W_BISHOP = 3, W_ROOK = 4, W_QUEEN = 5, W_KING = 6,
-    PIECE_7 = 7,
-    B_PAWN = 8, B_KNIGHT = 9, B_BISHOP = 10, B_ROOK = 11, B_QUEEN = 12, B_KING = 13,
-    PIECE_14 = 14, PIECE_15 = 15,
+    PIECE_7 = 7, PIECE_8 = 8,
+    B_PAWN = 9, B_KNIGHT = 10, B_BISHOP = 11, B_ROOK = 12, B_QUEEN = 13, B_KING = 14,
+    PIECE_15 = 15,
     PIECE_NB = 16
 };
 
@@ -113,16 +114,62 @@ constexpr Value VALUE_DRAW = 0;
 constexpr Value VALUE_MATE = 32000;
 constexpr Value VALUE_INFINITE = 32001;
 constexpr Value VALUE_NONE = 32002;
+constexpr Value VALUE_KNOWN_WIN = 10000;
 
-constexpr Depth MAX_PLY = 200;
+constexpr int MAX_PLY = 200;
 constexpr Depth DEPTH_ZERO = 0;
+constexpr Depth DEPTH_NONE = -6;
 constexpr Depth DEPTH_MAX = 127;
 
+constexpr Value VALUE_MATE_IN_MAX_PLY = VALUE_MATE - MAX_PLY;
+constexpr Value VALUE_MATED_IN_MAX_PLY = -VALUE_MATE_IN_MAX_PLY;
+
 constexpr Score SCORE_ZERO = 0;
 
+// A Score packs a middlegame value in the low 16 bits and an endgame value in
+// the high 16 bits, so one integer add updates both phases. The endgame half
+// is stored with the borrow from a negative middlegame value folded in.
+constexpr Score make_score(int mg, int eg)
+{
+    return Score(int(unsigned(eg) << 16) + mg);
+}
+
+inline Value eg_value(Score s)
+{
+    return Value(int16_t(uint16_t(unsigned(s + 0x8000) >> 16)));
+}
+
+inline Value mg_value(Score s)
+{
+    return Value(int16_t(uint16_t(unsigned(s))));
+}
+
+// Endgame score multiplier in 1/64ths.
+enum ScaleFactor : U8
+{
+    SCALE_FACTOR_DRAW = 0,
+    SCALE_FACTOR_NORMAL = 64,
+    SCALE_FACTOR_NONE = 255
+};
+
 constexpr U64 EMPTY_BB = 0ULL;
 constexpr U64 ALL_SQUARES_BB = ~EMPTY_BB;
 
+// Direct-mapped cache indexed by the low bits of a key. Size must be a power
+// of two; entries carry their own key so the caller can detect a miss.
+template<class Entry, int Size>
+struct HashTable
+{
+    static_assert((Size & (Size - 1)) == 0, "HashTable size must be a power of two");
+
+    HashTable() : table(Size) {}
+
+    Entry* operator[](Key key) { return &table[size_t(key) & (Size - 1)]; }
+
+private:
+    std::vector<Entry> table;
+};
+
 inline Color& operator++(Color& c) { return c = Color(int(c) + 1); }
 inline Color& operator--(Color& c) { return c = Color(int(c) - 1); }
 inline PieceType& operator++(PieceType& pt) { return pt = PieceType(int(pt) + 1); }
@@ -221,7 +268,7 @@ inline Square to_sq(Move m)
 
 inline MoveType type_of(Move m)
 {
-    return MoveType(m >> 12);
+    return MoveType((m >> 12) & 3);
 }
 
 inline PieceType promotion_type(Move m)
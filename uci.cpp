@@ -3,13 +3,219 @@
 #include "search.h"
 #include "move.h"
 #include "eval.h"
+#include "eval_batch.h"
+#include "tt.h"
+#include "nnue.h"
+#include "tune.h"
+#include "syzygy.h"
+#include "egtb.h"
+#include "cluster.h"
+#include "timeman.h"
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <thread>
 
 using namespace std;
 
+static const char* BenchFens[] =
+{
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "r1bqk2r/pp2bppp/2n1pn2/2pp4/3P4/2PBPN2/PP3PPP/RNBQ1RK1 w kq - 0 7",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"
+};
+
+// Time-to-depth and TT hit rate of the compiled cluster policy over the bench
+// positions at several hash sizes. Policies are compared by building with
+// different ZORN_TT_POLICY values and diffing the output. Each search is capped
+// so that one runaway tree cannot dominate the total; capped runs are counted.
+static void tt_bench(int depth)
+{
+    if (TT.is_shared())
+    {
+        cout << "info string ttbench needs a private hash, detach SharedHash first" << endl;
+        return;
+    }
+
+    const size_t hashSizes[] = { 1, 4, 16, 64 };
+    const size_t originalSize = TT.size_mb();
+    const bool statsWereEnabled = TT.stats_enabled();
+    const int timeCap = 10000;
+
+    TT.enable_stats(true);
+
+    cout << "ttbench policy " << TTPolicy::name() << " depth " << depth << endl;
+
+    for (size_t mb : hashSizes)
+    {
+        TT.resize(mb);
+        TT.clear();
+        TT.reset_stats();
+
+        uint64_t elapsed = 0;
+        int capped = 0;
+
+        for (const char* fen : BenchFens)
+        {
+            Position pos;
+            StateInfo st;
+            pos.set(fen, false, &st, Threads);
+
+            Search::Limits limits;
+            limits.depth = depth;
+            limits.movetime = timeCap;
+
+            auto start = chrono::steady_clock::now();
+            cout.setstate(ios_base::failbit);
+            Search::start(pos, limits);
+            cout.clear();
+
+            auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+            elapsed += ms;
+            capped += ms >= timeCap;
+        }
+
+        cout << "hash " << mb << "MB"
+            << " time " << elapsed << "ms"
+            << " probes " << TT.statistics().probes
+            << " hitrate " << (TT.statistics().probes ? TT.statistics().hits * 1000 / TT.statistics().probes : 0) / 10.0 << "%"
+            << " capped " << capped
+            << endl;
+    }
+
+    TT.resize(originalSize);
+    TT.enable_stats(statsWereEnabled);
+}
+
+// Cost of the NNUE building blocks over the bench positions: a full
+// accumulator refresh, an incremental update after each legal move (do/undo
+// overhead subtracted) and the forward pass through the dense layers.
+static void nnue_bench(int iterations)
+{
+    if (!NNUE::loaded())
+    {
+        NNUE::init_random(0x5EED);
+        cout << "info string No network loaded, timing random weights" << endl;
+    }
+
+    typedef chrono::steady_clock Clock;
+    auto ns = [](Clock::time_point a, Clock::time_point b) {
+        return uint64_t(chrono::duration_cast<chrono::nanoseconds>(b - a).count());
+    };
+
+    uint64_t refreshNs = 0, updateNs = 0, moveNs = 0, propagateNs = 0;
+    uint64_t refreshes = 0, updates = 0, propagations = 0;
+    int sink = 0;
+
+    for (const char* fen : BenchFens)
+    {
+        Position pos;
+        StateInfo st;
+        pos.set(fen, false, &st, Threads);
+
+        vector<Move> moves;
+        for (const auto& m : MoveList(pos))
+            if (pos.legal(m))
+                moves.push_back(m);
+
+        auto t0 = Clock::now();
+        for (int i = 0; i < iterations; ++i)
+            NNUE::refresh_accumulator(pos);
+        auto t1 = Clock::now();
+        for (int i = 0; i < iterations; ++i)
+            sink += NNUE::propagate(pos);
+        auto t2 = Clock::now();
+
+        for (int i = 0; i < iterations; ++i)
+            for (Move m : moves)
+            {
+                StateInfo st2;
+                pos.do_move(m, st2);
+                pos.undo_move(m);
+            }
+        auto t3 = Clock::now();
+
+        for (int i = 0; i < iterations; ++i)
+            for (Move m : moves)
+            {
+                StateInfo st2;
+                pos.do_move(m, st2);
+                NNUE::update_accumulator(pos);
+                pos.undo_move(m);
+            }
+        auto t4 = Clock::now();
+
+        refreshNs += ns(t0, t1);
+        propagateNs += ns(t1, t2);
+        moveNs += ns(t2, t3);
+        updateNs += ns(t3, t4);
+        refreshes += iterations;
+        propagations += iterations;
+        updates += uint64_t(iterations) * moves.size();
+    }
+
+    uint64_t update = updateNs > moveNs ? updateNs - moveNs : 0;
+
+    cout << "nnuebench simd " << NNUE::simd_name()
+        << " refresh " << refreshNs / refreshes << "ns"
+        << " update " << (updates ? update / updates : 0) << "ns"
+        << " propagate " << propagateNs / propagations << "ns"
+        << " (checksum " << sink << ")" << endl;
+}
+
+// Time from stop to bestmove over the bench positions: each is searched
+// with go infinite and stopped after a varying delay, then once more with a
+// movetime so the timer makes the stop.
+static void stop_bench(int rounds)
+{
+    double worst = 0, total = 0;
+    int stops = 0;
+
+    for (const char* fen : BenchFens)
+        for (int r = 0; r <= rounds; ++r)
+        {
+            Position pos;
+            StateInfo st;
+            pos.set(fen, false, &st, Threads);
+
+            Search::Limits limits;
+            if (r < rounds)
+                limits.infinite = 1;
+            else
+                limits.movetime = 100;
+
+            cout.setstate(ios_base::failbit);
+            Search::go(pos, limits, false);
+            if (r < rounds)
+            {
+                this_thread::sleep_for(chrono::milliseconds(20 + 37 * (r + stops) % 180));
+                Search::stop();
+            }
+            Search::wait();
+            cout.clear();
+
+            double latency = Search::stop_latency();
+            if (latency >= 0)
+            {
+                worst = max(worst, latency);
+                total += latency;
+                ++stops;
+            }
+        }
+
+    cout << "stopbench stops " << stops
+        << " bound " << Search::StopLatency << "ms"
+        << " worst " << worst << "ms"
+        << " average " << (stops ? total / stops : 0) << "ms" << endl;
+}
+
 static uint64_t perft(Position& pos, int depth)
 {
     if (depth == 0) return 1;
@@ -44,7 +250,7 @@ namespace UCI
         static StateInfo setupStates[1000];
         int stateIndex = 0;
 
-        pos.set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", false, &setupStates[0], nullptr);
+        pos.set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", false, &setupStates[0], Threads);
 
         for (int i = 1; i < argc; ++i)
             cmd += string(argv[i]) + " ";
@@ -59,23 +265,48 @@ namespace UCI
             token.clear();
             is >> skipws >> token;
 
+            // The search runs on its own thread. Only these four are served
+            // while it does; any other command waits for it to finish.
+            bool searchCommand = token == "quit" || token == "stop" || token == "ponderhit" || token == "isready";
+
+            if (!searchCommand && !token.empty())
+                Search::wait();
+
             if (token == "quit" || token == "stop")
-                break;
+                Search::stop();
+
+            else if (token == "ponderhit")
+                Search::ponderhit();
+
+            else if (token == "isready")
+                cout << "readyok" << endl;
 
             else if (token == "uci")
             {
                 cout << "id name Zorn 1.0" << endl;
                 cout << "id author Zorn Team" << endl;
+                Option::print();
                 cout << "uciok" << endl;
             }
 
-            else if (token == "isready")
-                cout << "readyok" << endl;
+            else if (token == "setoption")
+            {
+                string name, value;
+
+                is >> token;
+                while (is >> token && token != "value")
+                    name += (name.empty() ? "" : " ") + token;
+                while (is >> token)
+                    value += (value.empty() ? "" : " ") + token;
+
+                if (!Option::set(name, value))
+                    cout << "info string Unknown option: " << name << endl;
+            }
 
             else if (token == "ucinewgame")
             {
                 stateIndex = 0;
-                pos.set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", false, &setupStates[0], nullptr);
+                pos.set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", false, &setupStates[0], Threads);
             }
 
             else if (token == "position")
@@ -96,7 +327,7 @@ namespace UCI
                         fen += token + " ";
                 }
 
-                pos.set(fen, false, &setupStates[stateIndex++], nullptr);
+                pos.set(fen, false, &setupStates[stateIndex++], Threads);
 
                 if (token == "moves")
                 {
@@ -123,8 +354,7 @@ namespace UCI
             else if (token == "go")
             {
                 Search::Limits limits;
-                limits.depth = 8;
-                limits.movetime = 0;
+                bool ponder = false, searchMoves = false;
 
                 while (is >> token)
                 {
@@ -152,26 +382,201 @@ namespace UCI
                         is >> limits.nodes;
                     else if (token == "mate")
                         is >> limits.mate;
+                    else if (token == "ponder")
+                        ponder = true;
+                    else if (token == "searchmoves")
+                        searchMoves = true;
+                    else if (searchMoves)
+                    {
+                        // Moves follow until the next keyword
+                        Move m = UCI::to_move(pos, token);
+                        if (m != MOVE_NONE)
+                            limits.searchmoves.push_back(m);
+                    }
                 }
 
-                if (limits.movetime == 0 && limits.infinite == 0 && limits.time[pos.side_to_move()] > 0)
+                // A bare go keeps its old fixed depth; anything else is
+                // bounded by its own limit or the time manager
+                if (!limits.depth && !limits.movetime && !limits.nodes && !limits.infinite
+                    && !limits.time[pos.side_to_move()])
+                    limits.depth = 8;
+
+                Search::go(pos, limits, ponder);
+            }
+
+            else if (token == "d")
+                cout << pos << endl;
+
+            else if (token == "ttbench")
+            {
+                int depth = 7;
+                is >> depth;
+                tt_bench(depth);
+            }
+
+            else if (token == "stopbench")
+            {
+                int rounds = 5;
+                is >> rounds;
+                stop_bench(rounds);
+            }
+
+            else if (token == "nnuebench")
+            {
+                int iterations = 10000;
+                is >> iterations;
+                nnue_bench(iterations);
+            }
+
+            else if (token == "hashstats")
+            {
+                if (is >> token && token == "reset")
+                    TT.reset_stats();
+                else
                 {
-                    int timeLeft = limits.time[pos.side_to_move()];
-                    int increment = limits.inc[pos.side_to_move()];
-                    int movesToGo = limits.movestogo > 0 ? limits.movestogo : 40;
+                    if (!TT.stats_enabled())
+                        cout << "info string Counters are off, enable with setoption name HashStats value true" << endl;
+                    TT.print_stats(cout);
+                }
+            }
 
-                    limits.movetime = (timeLeft / movesToGo) + (increment * 4 / 5);
-                    limits.movetime = std::max(10, std::min(limits.movetime, timeLeft / 3));
+            else if (token == "evalprofile")
+            {
+                string fileName;
+                int iterations = 1000;
 
-                    if (timeLeft < 1000)
-                        limits.movetime = std::max(10, increment / 2);
+                if (!(is >> fileName))
+                    cout << "info string Usage: evalprofile <epd file> [iterations]" << endl;
+                else
+                {
+                    is >> iterations;
+                    Eval::profile(fileName, iterations);
                 }
+            }
 
-                Search::start(pos, limits);
+            else if (token == "evalbatch")
+            {
+                string fileName;
+                bool quiet = false, check = false;
+
+                if (!(is >> fileName))
+                    cout << "info string Usage: evalbatch <epd file> [quiet] [check]" << endl;
+                else
+                {
+                    while (is >> token)
+                        if (token == "quiet") quiet = true;
+                        else if (token == "check") check = true;
+
+                    Eval::evaluate_file(fileName, quiet, check);
+                }
             }
 
-            else if (token == "d")
-                cout << pos << endl;
+            else if (token == "tune")
+            {
+                Tune::Options options;
+
+                if (!(is >> options.dataFile))
+                    cout << "info string Usage: tune <dataset> [epochs n] [threads n] [lr x] [out file]" << endl;
+                else
+                {
+                    while (is >> token)
+                        if (token == "epochs") is >> options.epochs;
+                        else if (token == "threads") is >> options.threads;
+                        else if (token == "lr") is >> options.learningRate;
+                        else if (token == "out") is >> options.outFile;
+
+                    Tune::run(options);
+                }
+            }
+
+            else if (token == "clusterworker")
+            {
+                string address;
+
+                if (!(is >> address))
+                    cout << "info string Usage: clusterworker <host:port|unix:path>" << endl;
+                else
+                    Cluster::run_worker(address);
+            }
+
+            else if (token == "egtbgen")
+            {
+                string dir;
+                int threads = int(std::thread::hardware_concurrency());
+
+                if (!(is >> dir))
+                    cout << "info string Usage: egtbgen <dir> [threads]" << endl;
+                else
+                {
+                    is >> threads;
+                    EGTB::generate(dir, threads);
+                }
+            }
+
+            else if (token == "evalstats")
+            {
+                Eval::LazyStats& ls = Threads->lazyStats;
+
+                if (is >> token && token == "reset")
+                    ls = Eval::LazyStats();
+                else
+                {
+                    uint64_t exits = ls.exits[0] + ls.exits[1];
+                    cout << "info string evaluations " << ls.evaluations
+                        << " lazy " << exits
+                        << " (" << (ls.evaluations ? 100.0 * exits / ls.evaluations : 0.0) << "%)"
+                        << " low " << ls.exits[0] << " high " << ls.exits[1] << endl;
+                }
+            }
+
+            else if (token == "aspirationstats")
+            {
+                if (is >> token && token == "reset")
+                    for (Thread* th : ThreadPool)
+                        th->aspirationStats = Search::AspirationStats();
+                else
+                {
+                    Search::AspirationStats as;
+                    for (const Thread* th : ThreadPool)
+                    {
+                        as.iterations += th->aspirationStats.iterations;
+                        as.failLows += th->aspirationStats.failLows;
+                        as.failHighs += th->aspirationStats.failHighs;
+                    }
+
+                    uint64_t researches = as.failLows + as.failHighs;
+                    cout << "info string iterations " << as.iterations
+                        << " re-searches " << researches
+                        << " (" << (as.iterations ? double(researches) / as.iterations : 0.0) << " per iteration)"
+                        << " low " << as.failLows << " high " << as.failHighs << endl;
+                }
+            }
+
+            else if (token == "savehash")
+            {
+                string fileName, option;
+                is >> fileName >> option;
+
+                if (fileName.empty())
+                    cout << "info string Usage: savehash <file> [compact]" << endl;
+                else if (TT.save_to_file(fileName, option == "compact"))
+                    cout << "info string Hash saved to " << fileName << endl;
+                else
+                    cout << "info string Failed to save hash to " << fileName << endl;
+            }
+
+            else if (token == "loadhash")
+            {
+                string fileName;
+                is >> fileName;
+
+                if (fileName.empty())
+                    cout << "info string Usage: loadhash <file>" << endl;
+                else if (TT.load_from_file(fileName))
+                    cout << "info string Hash loaded from " << fileName << endl;
+                else
+                    cout << "info string Failed to load hash from " << fileName << endl;
+            }
 
             else if (token == "moves")
             {
@@ -196,6 +601,9 @@ namespace UCI
             else if (token == "eval")
             {
                 Value eval = Eval::evaluate(pos);
+                if (pos.side_to_move() == BLACK)
+                    eval = -eval;
+
                 cout << "Static evaluation: " << eval << " (cp)" << endl;
                 cout << "From WHITE perspective (positive = good for White)" << endl;
             }
@@ -216,6 +624,8 @@ namespace UCI
                         StateInfo st;
                         pos.do_move(m, st);
                         Value eval = Eval::evaluate(pos);
+                        if (pos.side_to_move() == BLACK)
+                            eval = -eval;
                         pos.undo_move(m);
 
                         cout << moveStr << ": " << eval << " cp" << endl;
@@ -306,6 +716,8 @@ namespace UCI
                         pos.do_move(m, st);
 
                         Value staticEval = Eval::evaluate(pos);
+                        if (pos.side_to_move() == BLACK)
+                            staticEval = -staticEval;
 
                         Search::Limits limits;
                         limits.depth = 6;
@@ -333,6 +745,9 @@ namespace UCI
             }
 
         } while (token != "quit" && argc == 1);
+
+        Search::wait();
+        Cluster::close();
     }
 
     string value(Value v)
@@ -377,7 +792,272 @@ namespace UCI
 
 namespace Option
 {
+    struct Entry
+    {
+        string name;
+        string type;
+        string defaultValue;
+        string currentValue;
+        int min;
+        int max;
+        OnChange onChange;
+    };
+
+    static vector<Entry> options;
+
+    static bool same_name(const string& a, const string& b)
+    {
+        return a.size() == b.size() && equal(a.begin(), a.end(), b.begin(),
+            [](char x, char y) { return tolower(x) == tolower(y); });
+    }
+
+    static Entry* find(const string& name)
+    {
+        for (auto& o : options)
+            if (same_name(o.name, name))
+                return &o;
+
+        return nullptr;
+    }
+
+    static void on_hash(const string& v)
+    {
+        if (TT.is_shared())
+            cout << "info string Hash size is fixed by the shared table" << endl;
+        else
+            TT.resize(size_t(stoll(v)));
+    }
+
+    static void on_hash_stats(const string& v)
+    {
+        TT.enable_stats(v == "true");
+    }
+
+    static void on_shared_hash(const string& v)
+    {
+        if (v.empty() || v == "<empty>")
+            TT.detach_shared();
+        else if (TT.attach_shared(v, size_t(integer("Hash"))))
+            cout << "info string Attached to shared hash " << v << " (" << TT.size_mb() << "MB)" << endl;
+        else
+            cout << "info string Failed to attach shared hash " << v << endl;
+
+        if (!TT.is_shared())
+            TT.resize(size_t(integer("Hash")));
+    }
+
+    // Every search thread keeps its own evaluation cache
+    static void clear_eval_caches()
+    {
+        for (Thread* th : ThreadPool)
+            th->evalCache.clear();
+    }
+
+    static void on_threads(const string& v)
+    {
+        Search::set_threads(size_t(stoi(v)));
+
+        for (Thread* th : ThreadPool)
+            th->evalCache.resize(size_t(integer("EvalCache")));
+    }
+
+    static void on_clear_hash(const string&)
+    {
+        if (TT.is_shared())
+            cout << "info string Shared hash not cleared, other processes use it" << endl;
+        TT.clear();
+        clear_eval_caches();
+    }
+
+    static void on_eval_cache(const string& v)
+    {
+        for (Thread* th : ThreadPool)
+            th->evalCache.resize(size_t(stoll(v)));
+    }
+
+    // The network is loaded lazily, when NNUE is switched on or the file
+    // changes while it is on. A failed load keeps the classical evaluation.
+    static void load_network()
+    {
+        const string file = value("EvalFile");
+
+        Eval::useNNUE = NNUE::load(file);
+        clear_eval_caches();
+
+        if (Eval::useNNUE)
+            cout << "info string NNUE evaluation using " << file << " (" << NNUE::simd_name() << ")" << endl;
+        else
+            cout << "info string Could not load network " << file << ", using classical evaluation" << endl;
+    }
+
+    static void on_use_nnue(const string& v)
+    {
+        if (v == "true")
+            load_network();
+        else
+        {
+            Eval::useNNUE = false;
+            clear_eval_caches();
+        }
+    }
+
+    static void on_eval_file(const string&)
+    {
+        if (value("UseNNUE") == "true")
+            load_network();
+    }
+
+    static void on_eval_config(const string& v)
+    {
+        Eval::set_config(v);
+        clear_eval_caches();
+    }
+
+    static void on_syzygy_path(const string& v)
+    {
+        Tablebases::init(v);
+    }
+
+    static void on_egtb_path(const string& v)
+    {
+        EGTB::init(v);
+    }
+
+    static void on_cluster_listen(const string& v)
+    {
+        if (v.empty() || v == "<empty>")
+            Cluster::close();
+        else if (Cluster::listen(v))
+            cout << "info string Cluster listening on " << v << endl;
+        else
+            cout << "info string Could not listen on " << v << endl;
+    }
+
+    static void on_cluster_share_depth(const string& v)
+    {
+        Cluster::ShareDepth = stoi(v);
+    }
+
+    static void on_syzygy_probe_depth(const string& v)
+    {
+        Tablebases::ProbeDepth = stoi(v);
+    }
+
+    static void on_move_overhead(const string& v)
+    {
+        Time.moveOverhead = stoi(v);
+    }
+
+    static void on_stop_latency(const string& v)
+    {
+        Search::StopLatency = stoi(v);
+    }
+
     void init()
     {
+        add("Threads", "spin", "1", 1, 512, on_threads);
+        add("Hash", "spin", "64", 1, 33554432, on_hash);
+        add("Move Overhead", "spin", "30", 0, 5000, on_move_overhead);
+        add("StopLatency", "spin", "5", 1, 1000, on_stop_latency);
+        add("Clear Hash", "button", "", 0, 0, on_clear_hash);
+        add("SharedHash", "string", "", 0, 0, on_shared_hash);
+        add("HashStats", "check", "false", 0, 0, on_hash_stats);
+        add("EvalCache", "spin", "4", 0, 1024, on_eval_cache);
+        add("UseNNUE", "check", "false", 0, 0, on_use_nnue);
+        add("EvalFile", "string", "zorn.nnue", 0, 0, on_eval_file);
+
+        string configs = Eval::DefaultEvalPolicy::name();
+        for (const string& name : Eval::config_names())
+            configs += " var " + name;
+
+        add("EvalConfig", "combo", configs, 0, 0, on_eval_config);
+        add("SyzygyPath", "string", "<empty>", 0, 0, on_syzygy_path);
+        add("SyzygyProbeDepth", "spin", "1", 1, 100, on_syzygy_probe_depth);
+        add("EGTBPath", "string", "<empty>", 0, 0, on_egtb_path);
+        add("ClusterListen", "string", "<empty>", 0, 0, on_cluster_listen);
+        add("ClusterShareDepth", "spin", "8", 1, 100, on_cluster_share_depth);
+    }
+
+    // A combo's defaultValue is the default followed by " var <choice>" for
+    // each allowed value, as it is printed.
+    void add(const string& name, const string& type, const string& defaultValue, int min, int max, OnChange onChange)
+    {
+        string current = type == "combo" ? defaultValue.substr(0, defaultValue.find(' ')) : defaultValue;
+        options.push_back({ name, type, defaultValue, current, min, max, onChange });
+    }
+
+    bool set(const string& name, const string& value)
+    {
+        Entry* o = find(name);
+        if (!o)
+            return false;
+
+        string v = value;
+
+        if (o->type == "spin")
+        {
+            try
+            {
+                v = to_string(std::max(o->min, std::min(o->max, stoi(value))));
+            }
+            catch (...)
+            {
+                return true;
+            }
+        }
+        else if (o->type == "check")
+        {
+            if (v != "true" && v != "false")
+                return true;
+        }
+        else if (o->type == "combo")
+        {
+            istringstream ss(o->defaultValue);
+            string token;
+            bool found = false;
+
+            while (!found && ss >> token)
+                if (token != "var" && same_name(token, value))
+                    v = token, found = true;
+
+            if (!found)
+                return true;
+        }
+
+        if (o->type != "button")
+            o->currentValue = v;
+
+        if (o->onChange)
+            o->onChange(v);
+
+        return true;
+    }
+
+    string value(const string& name)
+    {
+        Entry* o = find(name);
+        return o ? o->currentValue : string();
+    }
+
+    int integer(const string& name)
+    {
+        Entry* o = find(name);
+        return o && !o->currentValue.empty() ? stoi(o->currentValue) : 0;
+    }
+
+    void print()
+    {
+        for (const auto& o : options)
+        {
+            cout << "option name " << o.name << " type " << o.type;
+
+            if (o.type == "string" || o.type == "check" || o.type == "spin" || o.type == "combo")
+                cout << " default " << (o.defaultValue.empty() && o.type == "string" ? "<empty>" : o.defaultValue);
+
+            if (o.type == "spin")
+                cout << " min " << o.min << " max " << o.max;
+
+            cout << endl;
+        }
     }
 }
\ No newline at end of file
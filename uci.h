@@ -18,7 +18,15 @@ namespace UCI
 
 namespace Option
 {
+    typedef void (*OnChange)(const std::string& value);
+
     void init();
+    void add(const std::string& name, const std::string& type, const std::string& defaultValue,
+        int min = 0, int max = 0, OnChange onChange = nullptr);
+    bool set(const std::string& name, const std::string& value);
+    std::string value(const std::string& name);
+    int integer(const std::string& name);
+    void print();
 }
 
 #endif
\ No newline at end of file